@@ -0,0 +1,32 @@
+#include "attractors.h"
+
+#include <algorithm>
+#include <cmath>
+
+float max_attractor_radius(const std::vector<Attractor>& attractors) {
+    float radius = 0.0f;
+    for (const auto& a : attractors) radius = std::max(radius, a.radius);
+    return radius;
+}
+
+void apply_attractors(WorkerPool& pool, const UniformGrid& index, float slack, BoidVector& boids,
+                      const std::vector<Attractor>& attractors, float deltaTime) {
+    unsigned int num_threads = pool.size();
+    for (const auto& a : attractors) {
+        if (a.radius <= 0.0f || a.strength == 0.0f) continue;
+        const float scale = a.strength * deltaTime;
+        pool.run([&](unsigned int t) {
+            index.for_each_in_box(a.x, a.y, a.radius + slack, t, num_threads, [&](int j) {
+                Boid& b = boids[j];
+                float dx = a.x - b.x;
+                float dy = a.y - b.y;
+                float dist_squared = dx*dx + dy*dy;
+                if (dist_squared >= a.radius*a.radius || dist_squared == 0.0f) return;
+                float dist = std::sqrt(dist_squared);
+                float push = scale * (1.0f - dist / a.radius) / dist;
+                b.vx += dx * push;
+                b.vy += dy * push;
+            });
+        });
+    }
+}
@@ -0,0 +1,36 @@
+//
+// Attractor and repeller points that pull or push the boids near them,
+// found through a cell grid so the cost follows the boids in reach rather
+// than the size of the flock.
+//
+
+#ifndef ATTRACTORS_H
+#define ATTRACTORS_H
+
+#include <vector>
+
+#include "boids_parallel.h"
+#include "neighbor_grid.h"
+
+#define ATTRACTOR_RADIUS 150.0f
+// Velocity change per second at the centre, fading to 0 at the radius
+#define ATTRACTOR_STRENGTH 200.0f
+
+struct Attractor {
+    float x = 0.0f, y = 0.0f;
+    float radius = ATTRACTOR_RADIUS;
+    float strength = ATTRACTOR_STRENGTH; // negative repels
+};
+
+// Largest radius among the attractors, a good cell size for a dedicated index
+float max_attractor_radius(const std::vector<Attractor>& attractors);
+
+// Steers every boid within radius of an attractor towards it (away for a
+// negative strength). Only the cells of index around each attractor are
+// visited; index may have binned the boids up to slack away from where
+// they are now. Attractors are applied one after the other, each split
+// over the pool by rows of cells.
+void apply_attractors(WorkerPool& pool, const UniformGrid& index, float slack, BoidVector& boids,
+                      const std::vector<Attractor>& attractors, float deltaTime);
+
+#endif //ATTRACTORS_H
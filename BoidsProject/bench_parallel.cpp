@@ -0,0 +1,102 @@
+// Headless benchmark of the parallel update, no window needed.
+// Usage: BoidsBench [num_boids] [steps] [spin_iters] [pool_threads] [layout|state.bckp]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "hilbert_partition.h"
+#include "initial_state.h"
+
+#define BENCH_DT (1.0f / 60.0f)
+#define BENCH_SEED 42
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int num_boids = argc > 1 ? atoi(argv[1]) : 2000;
+    int steps = argc > 2 ? atoi(argv[2]) : 200;
+    unsigned int spin_iters = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : DEFAULT_SPIN_ITERS;
+    unsigned int pool_threads = argc > 4 ? static_cast<unsigned int>(atoi(argv[4])) : NUM_THREADS;
+
+    const char* source = argc > 5 ? argv[5] : "uniform";
+
+    // Every variant starts from this exact state
+    WorkerPool pool(pool_threads, spin_iters);
+    BoidVector initial;
+    InitialLayout layout;
+    if (parse_layout(source, &layout)) {
+        generate_boids(pool, initial, layout, num_boids, BENCH_SEED);
+    } else if (!load_state(pool, source, initial)) {
+        fprintf(stderr, "%s is neither a layout nor a state file\n", source);
+        return 1;
+    }
+    num_boids = static_cast<int>(initial.size());
+
+    printf("boids %d (%s), steps %d, threads %u (pool %u), spin %u\n", num_boids, source, steps, NUM_THREADS,
+           pool_threads, spin_iters);
+
+    // Thread creation and join on every step
+    BoidVector boids = initial;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        update_boids_parallel_spawn(boids, BENCH_DT);
+    }
+    printf("spawn/join   %9.3f ms/step\n", seconds_since(start) * 1e3 / steps);
+
+    // Persistent pool synchronised by the step barrier
+    boids = initial;
+    double wait_total = 0.0, wait_max = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        update_boids_parallel(pool, boids, BENCH_DT);
+        wait_total += pool.last_barrier_wait_total();
+        wait_max += pool.last_barrier_wait_max();
+    }
+    printf("worker pool  %9.3f ms/step\n", seconds_since(start) * 1e3 / steps);
+    printf("barrier wait %9.3f us/step per thread, %9.3f us/step for the earliest thread\n",
+           wait_total * 1e6 / steps / pool.size(), wait_max * 1e6 / steps);
+
+    // Same pool reading per-boid attributes that all hold the defaults
+    boids = initial;
+    BoidAttributes attrs;
+    attrs.resize(boids.size(), DEFAULT_PARAMS);
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        update_boids_parallel(pool, boids, BENCH_DT, DEFAULT_PARAMS, attrs);
+    }
+    printf("per-boid     %9.3f ms/step\n", seconds_since(start) * 1e3 / steps);
+
+    // Same pool with a 270 degree vision cone
+    boids = initial;
+    BoidParams fov_params;
+    fov_params.field_of_view = 270.0f;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        update_boids_parallel(pool, boids, BENCH_DT, fov_params);
+    }
+    printf("fov 270      %9.3f ms/step\n", seconds_since(start) * 1e3 / steps);
+
+    // Equal-work segments of the Hilbert curve, costed by the brute-force pass and last step's neighbours
+    boids = initial;
+    HilbertPartitioner partitioner;
+    double imbalance = 0.0;
+    wait_total = 0.0;
+    wait_max = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        partitioner.update(pool, boids, BENCH_DT);
+        wait_total += pool.last_barrier_wait_total();
+        wait_max += pool.last_barrier_wait_max();
+        imbalance += partitioner.predicted_imbalance();
+    }
+    printf("hilbert      %9.3f ms/step, predicted imbalance %.3f\n",
+           seconds_since(start) * 1e3 / steps, imbalance / steps);
+    printf("barrier wait %9.3f us/step per thread, %9.3f us/step for the earliest thread\n",
+           wait_total * 1e6 / steps / pool.size(), wait_max * 1e6 / steps);
+    return 0;
+}
@@ -0,0 +1,250 @@
+//
+// The flocking rules of a single boid, split into the per-neighbour
+// accumulation and the steering applied afterwards, so the brute-force
+// kernel and the grid kernels share one definition.
+//
+
+#ifndef BOID_RULES_H
+#define BOID_RULES_H
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "boids_parallel.h"
+
+// Accumulator policies for the neighbour sums. Each reads back as a float,
+// so the steering after the loop is the same code for all of them.
+
+// Plain float, fastest; the rounding depends on the order of the neighbours
+struct FloatSum {
+    float sum;
+
+    FloatSum(float value = 0.0f) : sum(value) {}
+    FloatSum& operator+=(float value) { sum += value; return *this; }
+    FloatSum& operator*=(float factor) { sum *= factor; return *this; }
+    FloatSum& operator/=(float divisor) { sum /= divisor; return *this; }
+    operator float() const { return sum; }
+};
+
+// Double, twice the register width for 29 more bits
+struct DoubleSum {
+    double sum;
+
+    DoubleSum(float value = 0.0f) : sum(value) {}
+    DoubleSum& operator+=(float value) { sum += value; return *this; }
+    DoubleSum& operator*=(float factor) { sum *= factor; return *this; }
+    DoubleSum& operator/=(float divisor) { sum /= divisor; return *this; }
+    operator float() const { return static_cast<float>(sum); }
+};
+
+// Kahan-compensated float: the low bits every addition rounds away are
+// carried in lost and fed back into the next one, so the error stays a
+// few ulp of the total however many neighbours there are. Needs the
+// strict float semantics the build uses; -ffast-math folds lost to 0.
+struct KahanSum {
+    float sum, lost = 0.0f;
+
+    KahanSum(float value = 0.0f) : sum(value) {}
+    KahanSum& operator+=(float value) {
+        float y = value - lost;
+        float t = sum + y;
+        lost = (t - sum) - y;
+        sum = t;
+        return *this;
+    }
+    KahanSum& operator*=(float factor) { sum *= factor; lost *= factor; return *this; }
+    KahanSum& operator/=(float divisor) { sum /= divisor; lost /= divisor; return *this; }
+    operator float() const { return sum - lost; }
+};
+
+template <typename Sum = FloatSum>
+struct NeighborSums {
+    Sum xpos_avg, ypos_avg, xvel_avg, yvel_avg;
+    int neighboring_boids = 0, close_boids = 0;
+    Sum close_dx, close_dy;
+    Sum avoid_dx, avoid_dy; // time-to-collision push
+};
+
+// Heading of a boid and the half-angle of its field of view
+struct ViewCone {
+    float hx = 0, hy = 0;
+    float min_cos = -1; // cosine of half the field of view
+};
+
+inline bool fov_enabled(const BoidParams& params) {
+    return params.field_of_view < 360.0f;
+}
+
+// How far ahead and for what contact distance the time-to-collision rule looks
+struct Lookahead {
+    float horizon = 0; // seconds
+    float radius = 1;
+};
+
+inline bool ttc_enabled(const BoidParams& params) {
+    return params.ttc_horizon > 0.0f;
+}
+
+inline Lookahead lookahead(const BoidParams& params) {
+    Lookahead ahead;
+    ahead.horizon = params.ttc_horizon;
+    ahead.radius = params.collision_radius;
+    return ahead;
+}
+
+template <typename Sum, typename Fn>
+inline decltype(auto) dispatch_switches(bool per_boid, bool fov, bool ttc, Fn&& fn) {
+    using T = std::true_type;
+    using F = std::false_type;
+    if (per_boid) {
+        if (fov) return ttc ? fn(T(), T(), T(), Sum()) : fn(T(), T(), F(), Sum());
+        return ttc ? fn(T(), F(), T(), Sum()) : fn(T(), F(), F(), Sum());
+    }
+    if (fov) return ttc ? fn(F(), T(), T(), Sum()) : fn(F(), T(), F(), Sum());
+    return ttc ? fn(F(), F(), T(), Sum()) : fn(F(), F(), F(), Sum());
+}
+
+// Turns the runtime kernel switches into compile-time ones: fn gets a
+// std::true_type or std::false_type for PerBoid, Fov and Ttc and a value
+// of the accumulator policy, so every combination is its own
+// instantiation without branches in the neighbour loop
+template <typename Fn>
+inline decltype(auto) dispatch_kernel(bool per_boid, bool fov, bool ttc, int accumulator, Fn&& fn) {
+    if (accumulator == ACCUMULATE_DOUBLE) return dispatch_switches<DoubleSum>(per_boid, fov, ttc, fn);
+    if (accumulator == ACCUMULATE_KAHAN) return dispatch_switches<KahanSum>(per_boid, fov, ttc, fn);
+    return dispatch_switches<FloatSum>(per_boid, fov, ttc, fn);
+}
+
+inline ViewCone view_cone(const Boid& boid, const BoidParams& params) {
+    ViewCone cone;
+    float speed = std::sqrt(boid.vx*boid.vx + boid.vy*boid.vy);
+    // A boid at rest has no front and keeps seeing all around
+    if (speed > 0) {
+        cone.hx = boid.vx / speed;
+        cone.hy = boid.vy / speed;
+        cone.min_cos = std::cos(params.field_of_view * 0.5f * 3.14159265f / 180.0f);
+    }
+    return cone;
+}
+
+// Adds other to the sums of boid if it is within visual_range and, with
+// Fov, inside the view cone. With Ttc, a visible neighbour on course to
+// come within ahead.radius in less than ahead.horizon seconds also adds a
+// push away from where it will be at that moment, stronger the sooner.
+template <bool Fov = false, bool Ttc = false, typename Sum>
+inline void accumulate_neighbor(const Boid& boid, const Boid& other, float visual_range, float protected_range,
+                                NeighborSums<Sum>& sums, const ViewCone& cone = ViewCone(),
+                                const Lookahead& ahead = Lookahead()) {
+    float dx = boid.x - other.x;
+    float dy = boid.y - other.y;
+
+    if (std::abs(dx) < visual_range && std::abs(dy) < visual_range) {
+        float dist_squared = dx*dx + dy*dy;
+
+        // Cosine of the angle between the heading and the direction to other,
+        // compared without dividing. It is folded with & into the conditions
+        // of the if / else if on the ranges, which still branch, instead of
+        // adding a test of its own.
+        bool visible = true;
+        if (Fov) visible = -(dx*cone.hx + dy*cone.hy) >= cone.min_cos * std::sqrt(dist_squared);
+
+        if (visible & (dist_squared < protected_range*protected_range)) {
+            sums.close_dx += dx;
+            sums.close_dy += dy;
+            sums.close_boids++;
+        } else if (visible & (dist_squared < visual_range*visual_range)) {
+            sums.xpos_avg += other.x;
+            sums.ypos_avg += other.y;
+            sums.xvel_avg += other.vx;
+            sums.yvel_avg += other.vy;
+            sums.neighboring_boids++;
+        }
+
+        if (Ttc) {
+            // Other sits at d = -(dx, dy) and moves at w relative to boid;
+            // contact is the first root of |d + w t|^2 = radius^2.
+            // Computed for every pair in the box and selected with hit rather
+            // than tested; Ttc itself is a template switch, not a runtime one.
+            float wx = other.vx - boid.vx;
+            float wy = other.vy - boid.vy;
+            float a = wx*wx + wy*wy;
+            float b = -(dx*wx + dy*wy);
+            float c = dist_squared - ahead.radius*ahead.radius;
+            float disc = b*b - a*c;
+            float t = (-b - std::sqrt(std::max(disc, 0.0f))) / std::max(a, 1e-6f);
+            // Closing in, not touching yet, and the paths do meet within the horizon
+            bool hit = visible & (b < 0) & (c > 0) & (disc > 0) & (t < ahead.horizon);
+            // The contact offset is radius long, dividing by it makes a unit push
+            float weight = hit ? (ahead.horizon - t) / (ahead.horizon * ahead.radius) : 0.0f;
+            sums.avoid_dx += weight * (dx - wx*t);
+            sums.avoid_dy += weight * (dy - wy*t);
+        }
+    }
+}
+
+// Applies cohesion, alignment, separation, collision avoidance, the
+// boundary turn, the scout bias and the speed limits to the velocity.
+// The sums are in the frame of boid.x and boid.y, (world_x, world_y) is
+// where the boid is for the boundary turn. Returns the neighbour count.
+template <typename Sum>
+inline int steer_velocity(Boid& boid, NeighborSums<Sum>& sums, float world_x, float world_y, float deltaTime,
+                          const BoidParams& params, float min_speed, float max_speed) {
+    if (sums.neighboring_boids > 0) {
+        sums.xpos_avg /= sums.neighboring_boids;
+        sums.ypos_avg /= sums.neighboring_boids;
+        sums.xvel_avg /= sums.neighboring_boids;
+        sums.yvel_avg /= sums.neighboring_boids;
+
+        boid.vx += (sums.xpos_avg - boid.x) * params.centering_factor + (sums.xvel_avg - boid.vx) * params.matching_factor;
+        boid.vy += (sums.ypos_avg - boid.y) * params.centering_factor + (sums.yvel_avg - boid.vy) * params.matching_factor;
+    }
+
+    boid.vx += sums.close_dx * params.avoid_factor * deltaTime;
+    boid.vy += sums.close_dy * params.avoid_factor * deltaTime;
+    boid.vx += sums.avoid_dx * params.ttc_factor * deltaTime;
+    boid.vy += sums.avoid_dy * params.ttc_factor * deltaTime;
+
+    // Boundary turn
+    if (world_x < 0) boid.vx += params.turn_factor;
+    if (world_x > params.width) boid.vx -= params.turn_factor;
+    if (world_y < 0) boid.vy += params.turn_factor;
+    if (world_y > params.height) boid.vy -= params.turn_factor;
+
+    // Bias dynamics
+    if (boid.scout_group == 1) {
+        if (boid.vx > 0) boid.biasval = std::min(params.max_bias, boid.biasval + params.bias_increment);
+        else boid.biasval = std::max(params.bias_increment, boid.biasval - params.bias_increment);
+    } else if (boid.scout_group == 2) {
+        if (boid.vx < 0) boid.biasval = std::min(params.max_bias, boid.biasval + params.bias_increment);
+        else boid.biasval = std::max(params.bias_increment, boid.biasval - params.bias_increment);
+    }
+
+    // Apply bias
+    if (boid.scout_group == 1) {
+        boid.vx = (1 - boid.biasval)*boid.vx + boid.biasval;
+    } else if (boid.scout_group == 2) {
+        boid.vx = (1 - boid.biasval)*boid.vx - boid.biasval;
+    }
+
+    // Speed control
+    float speed = std::sqrt(boid.vx*boid.vx + boid.vy*boid.vy);
+    if (speed < min_speed || speed > max_speed) {
+        boid.vx = (boid.vx / speed) * clamp(speed, min_speed, max_speed);
+        boid.vy = (boid.vy / speed) * clamp(speed, min_speed, max_speed);
+    }
+
+    return sums.neighboring_boids + sums.close_boids;
+}
+
+// steer_velocity with the boid where its x and y say, then moves the boid
+template <typename Sum>
+inline int steer_boid(Boid& boid, NeighborSums<Sum>& sums, float deltaTime, const BoidParams& params,
+                      float min_speed, float max_speed) {
+    int seen = steer_velocity(boid, sums, boid.x, boid.y, deltaTime, params, min_speed, max_speed);
+    boid.x += boid.vx * deltaTime;
+    boid.y += boid.vy * deltaTime;
+    return seen;
+}
+
+#endif //BOID_RULES_H
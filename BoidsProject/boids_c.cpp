@@ -0,0 +1,136 @@
+#include "boids_c.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include "boids_world.h"
+
+struct boids_world {
+    BoidsWorld world;
+
+    boids_world(const BoidParams& params, unsigned int num_threads) : world(params, num_threads) {}
+};
+
+// Copies only the fields the caller's header knew about
+static BoidParams to_params(const boids_params* in) {
+    boids_params full;
+    boids_default_params(&full);
+    if (in) {
+        size_t n = in->size < sizeof(full) ? in->size : sizeof(full);
+        std::memcpy(&full, in, n);
+    }
+
+    BoidParams p;
+    p.width = full.width;
+    p.height = full.height;
+    p.visual_range = full.visual_range;
+    p.protected_range = full.protected_range;
+    p.centering_factor = full.centering_factor;
+    p.avoid_factor = full.avoid_factor;
+    p.matching_factor = full.matching_factor;
+    p.turn_factor = full.turn_factor;
+    p.min_speed = full.min_speed;
+    p.max_speed = full.max_speed;
+    p.max_bias = full.max_bias;
+    p.bias_increment = full.bias_increment;
+    p.field_of_view = full.field_of_view;
+    p.max_neighbors = full.max_neighbors;
+    p.ttc_horizon = full.ttc_horizon;
+    p.ttc_factor = full.ttc_factor;
+    p.collision_radius = full.collision_radius;
+    p.accumulator = full.accumulator;
+    return p;
+}
+
+int boids_abi_version(void) {
+    return BOIDS_ABI_VERSION;
+}
+
+void boids_default_params(boids_params* params) {
+    if (!params) return;
+    BoidParams p;
+    params->size = sizeof(boids_params);
+    params->width = p.width;
+    params->height = p.height;
+    params->visual_range = p.visual_range;
+    params->protected_range = p.protected_range;
+    params->centering_factor = p.centering_factor;
+    params->avoid_factor = p.avoid_factor;
+    params->matching_factor = p.matching_factor;
+    params->turn_factor = p.turn_factor;
+    params->min_speed = p.min_speed;
+    params->max_speed = p.max_speed;
+    params->max_bias = p.max_bias;
+    params->bias_increment = p.bias_increment;
+    params->field_of_view = p.field_of_view;
+    params->max_neighbors = p.max_neighbors;
+    params->ttc_horizon = p.ttc_horizon;
+    params->ttc_factor = p.ttc_factor;
+    params->collision_radius = p.collision_radius;
+    params->accumulator = p.accumulator;
+}
+
+boids_world* boids_create(const boids_params* params, int num_boids, unsigned int seed, unsigned int num_threads) {
+    try {
+        auto* w = new boids_world(to_params(params), num_threads ? num_threads : NUM_THREADS);
+        w->world.populate(num_boids > 0 ? num_boids : 0, seed);
+        return w;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void boids_destroy(boids_world* world) {
+    delete world;
+}
+
+int boids_set_params(boids_world* world, const boids_params* params) {
+    if (!world || !params) return -1;
+    world->world.set_params(to_params(params));
+    return 0;
+}
+
+int boids_step(boids_world* world, int steps, float dt) {
+    if (!world) return -1;
+    try {
+        world->world.step(steps, dt);
+    } catch (...) {
+        return -1;
+    }
+    return 0;
+}
+
+int boids_count(const boids_world* world) {
+    return world ? world->world.size() : 0;
+}
+
+void boids_get_state(const boids_world* world, boids_state* state) {
+    if (!state) return;
+    std::memset(state, 0, sizeof(*state));
+    if (!world) return;
+
+    const Boid* base = world->world.boids().data();
+    state->count = world->world.size();
+    state->stride = sizeof(Boid);
+    state->x = &base->x;
+    state->y = &base->y;
+    state->vx = &base->vx;
+    state->vy = &base->vy;
+    state->scout_group = &base->scout_group;
+}
+
+int boids_spawn(boids_world* world, float x, float y, float vx, float vy, int scout_group) {
+    if (!world) return -1;
+    try {
+        return world->world.spawn(x, y, vx, vy, scout_group);
+    } catch (...) {
+        return -1;
+    }
+}
+
+int boids_remove(boids_world* world, int index) {
+    if (!world || index < 0 || index >= world->world.size()) return -1;
+    world->world.remove(index);
+    return 0;
+}
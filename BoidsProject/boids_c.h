@@ -0,0 +1,77 @@
+/*
+ * Stable C interface to the boids engine, shipped as libboids.so.
+ * No SFML and no C++ types cross this boundary.
+ */
+
+#ifndef BOIDS_C_H
+#define BOIDS_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define BOIDS_API __declspec(dllexport)
+#else
+#define BOIDS_API __attribute__((visibility("default")))
+#endif
+
+#define BOIDS_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct boids_world boids_world;
+
+/* Fill with boids_default_params(); `size` lets newer libraries accept
+ * structs from hosts built against an older header. */
+typedef struct boids_params {
+    size_t size;
+    float width, height;
+    float visual_range, protected_range;
+    float centering_factor, avoid_factor, matching_factor, turn_factor;
+    float min_speed, max_speed;
+    float max_bias, bias_increment;
+    float field_of_view; /* degrees, 360 sees all around */
+    int max_neighbors;   /* neighbours sampled on the grid kernels, 0 for all */
+    float ttc_horizon;   /* seconds of time-to-collision lookahead, 0 for off */
+    float ttc_factor;
+    float collision_radius;
+    int accumulator;     /* 0 float, 1 double, 2 Kahan-compensated float sums */
+} boids_params;
+
+/* Read-only view of the state. Fields of boid i live at
+ * (const char*)x + i * stride, and so on for the other pointers.
+ * Valid until the next call that spawns or removes boids. */
+typedef struct boids_state {
+    int count;
+    size_t stride;
+    const float* x;
+    const float* y;
+    const float* vx;
+    const float* vy;
+    const int* scout_group;
+} boids_state;
+
+BOIDS_API int boids_abi_version(void);
+BOIDS_API void boids_default_params(boids_params* params);
+
+/* num_threads 0 uses every hardware thread. Returns NULL on failure. */
+BOIDS_API boids_world* boids_create(const boids_params* params, int num_boids, unsigned int seed,
+                                    unsigned int num_threads);
+BOIDS_API void boids_destroy(boids_world* world);
+
+BOIDS_API int boids_set_params(boids_world* world, const boids_params* params);
+BOIDS_API int boids_step(boids_world* world, int steps, float dt);
+BOIDS_API int boids_count(const boids_world* world);
+BOIDS_API void boids_get_state(const boids_world* world, boids_state* state);
+
+/* Returns the index of the new boid, or -1 on failure */
+BOIDS_API int boids_spawn(boids_world* world, float x, float y, float vx, float vy, int scout_group);
+/* The last boid takes the removed one's index. Returns 0, or -1 if index is out of range */
+BOIDS_API int boids_remove(boids_world* world, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOIDS_C_H */
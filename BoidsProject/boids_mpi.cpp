@@ -0,0 +1,82 @@
+// Headless distributed run: one domain per MPI rank, a worker pool inside each rank.
+// Usage: mpirun -np R BoidsMPI [num_boids] [steps] [threads_per_rank] [rebalance_every]
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "distributed_world.h"
+
+#define MPI_DT (1.0f / 60.0f)
+
+int main(int argc, char** argv) {
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int num_boids = argc > 1 ? atoi(argv[1]) : 20000;
+    int steps = argc > 2 ? atoi(argv[2]) : 100;
+    // Every rank parses the same arguments, so they all stop here together
+    if (num_boids < 0 || steps <= 0) {
+        int rank = 0;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if (rank == 0) {
+            fprintf(stderr, "usage: mpirun -np R %s [num_boids] [steps > 0] [threads_per_rank] [rebalance_every]\n",
+                    argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Share the cores of a host between the ranks running on it
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    int ranks_on_node = 1;
+    MPI_Comm_size(node_comm, &ranks_on_node);
+    MPI_Comm_free(&node_comm);
+    unsigned int threads = argc > 3 ? static_cast<unsigned int>(atoi(argv[3]))
+                                    : std::max(1u, NUM_THREADS / static_cast<unsigned int>(ranks_on_node));
+
+    int rebalance_every = argc > 4 ? atoi(argv[4]) : 25;
+
+    DistributedWorld world(MPI_COMM_WORLD, num_boids, 42);
+    WorkerPool pool(threads);
+    if (world.rank() == 0) {
+        printf("boids %d, steps %d, ranks %d, threads per rank %u\n", num_boids, steps, world.size(), threads);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int s = 0; s < steps; s++) {
+        if (rebalance_every > 0 && s > 0 && s % rebalance_every == 0) {
+            RebalanceReport report = world.rebalance();
+            if (world.rank() == 0) {
+                printf("step %5d rebalance: imbalance %.3f -> %.3f\n", s, report.imbalance_before,
+                       report.imbalance_after);
+            }
+        }
+        world.step(pool, MPI_DT);
+    }
+
+    const HaloStats& st = world.stats();
+    double local[6] = {st.step_seconds, st.interior_seconds, st.border_seconds,
+                       st.comm_seconds, st.exposed_seconds, static_cast<double>(st.ghosts_received)};
+    double worst[6], sum[6];
+    MPI_Reduce(local, worst, 6, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local, sum, 6, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    long total = world.total_boids();
+
+    if (world.rank() == 0) {
+        double per_step = 1e3 / steps;
+        printf("step      %9.3f ms (slowest rank)\n", worst[0] * per_step);
+        printf("interior  %9.3f ms, border %9.3f ms\n", worst[1] * per_step, worst[2] * per_step);
+        printf("halo      %9.3f ms in flight, %9.3f ms exposed (rank average)\n",
+               sum[3] * per_step / world.size(), sum[4] * per_step / world.size());
+        double hidden = sum[3] > 0.0 ? 100.0 * std::max(0.0, 1.0 - sum[4] / sum[3]) : 100.0;
+        printf("hidden    %9.1f %% of the halo exchange, %.0f ghosts/step\n", hidden, sum[5] / steps);
+        printf("boids     %ld after the run\n", total);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
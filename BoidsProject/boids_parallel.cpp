@@ -0,0 +1,165 @@
+#include "boids_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+
+#include "boid_rules.h"
+
+float randf(float min, float max) {
+    return min + static_cast<float>(rand()) / RAND_MAX * (max - min);
+}
+
+float clamp(float value, float min, float max) {
+    return std::fmax(min, std::fmin(value, max));
+}
+
+void BoidAttributes::resize(size_t count, const BoidParams& params) {
+    visual_range.resize(count, params.visual_range);
+    min_speed.resize(count, params.min_speed);
+    max_speed.resize(count, params.max_speed);
+}
+
+void BoidAttributes::resize_unset(size_t count) {
+    visual_range.resize(count);
+    min_speed.resize(count);
+    max_speed.resize(count);
+}
+
+void BoidAttributes::push_back(const BoidParams& params) {
+    visual_range.push_back(params.visual_range);
+    min_speed.push_back(params.min_speed);
+    max_speed.push_back(params.max_speed);
+}
+
+void BoidAttributes::remove(size_t i) {
+    visual_range[i] = visual_range.back();
+    min_speed[i] = min_speed.back();
+    max_speed[i] = max_speed.back();
+    visual_range.pop_back();
+    min_speed.pop_back();
+    max_speed.pop_back();
+}
+
+float BoidAttributes::max_visual_range(const BoidParams& params) const {
+    if (empty()) return params.visual_range;
+    return *std::max_element(visual_range.begin(), visual_range.end());
+}
+
+// Updates boids[i] in place and returns how many boids it saw within its
+// visual range. PerBoid reads the speed limits and the visual range from
+// attrs; the uniform instantiation never touches attrs and keeps them in
+// registers for the whole neighbour loop. Fov masks out the boids behind
+// the view cone, Ttc adds the time-to-collision push. Sum is the
+// accumulator policy of the neighbour sums.
+template <bool PerBoid, bool Fov, bool Ttc, typename Sum>
+static inline int update_boid_impl(BoidVector& boids, int i, float deltaTime, const BoidParams& params,
+                                   const BoidAttributes* attrs) {
+    auto& boid = boids[i];
+    const float visual_range = PerBoid ? attrs->visual_range[i] : params.visual_range;
+    const float min_speed = PerBoid ? attrs->min_speed[i] : params.min_speed;
+    const float max_speed = PerBoid ? attrs->max_speed[i] : params.max_speed;
+    const ViewCone cone = Fov ? view_cone(boid, params) : ViewCone();
+    const Lookahead ahead = lookahead(params);
+    NeighborSums<Sum> sums;
+
+    for (const auto& other : boids) {
+        if (&boid == &other) continue;
+        accumulate_neighbor<Fov, Ttc>(boid, other, visual_range, params.protected_range, sums, cone, ahead);
+    }
+
+    return steer_boid(boid, sums, deltaTime, params, min_speed, max_speed);
+}
+
+// Picks the kernel specialisation once per range rather than per boid
+static void update_range(BoidVector& boids, int start_idx, int end_idx, float deltaTime,
+                         const BoidParams& params, const BoidAttributes* attrs) {
+    bool per_boid = attrs && !attrs->empty();
+    dispatch_kernel(per_boid, fov_enabled(params), ttc_enabled(params), params.accumulator,
+                    [&](auto per_boid_t, auto fov_t, auto ttc_t, auto sum_t) {
+        for (int i = start_idx; i < end_idx; i++) {
+            update_boid_impl<per_boid_t.value, fov_t.value, ttc_t.value, decltype(sum_t)>(boids, i, deltaTime, params,
+                                                                                         attrs);
+        }
+    });
+}
+
+int update_boid(BoidVector& boids, int i, float deltaTime, const BoidParams& params) {
+    return dispatch_kernel(false, fov_enabled(params), ttc_enabled(params), params.accumulator,
+                           [&](auto per_boid_t, auto fov_t, auto ttc_t, auto sum_t) {
+        return update_boid_impl<per_boid_t.value, fov_t.value, ttc_t.value, decltype(sum_t)>(boids, i, deltaTime, params,
+                                                                                            nullptr);
+    });
+}
+
+int update_boid(BoidVector& boids, int i, float deltaTime, const BoidParams& params,
+                const BoidAttributes& attrs) {
+    if (attrs.empty()) return update_boid(boids, i, deltaTime, params);
+    return dispatch_kernel(true, fov_enabled(params), ttc_enabled(params), params.accumulator,
+                           [&](auto per_boid_t, auto fov_t, auto ttc_t, auto sum_t) {
+        return update_boid_impl<per_boid_t.value, fov_t.value, ttc_t.value, decltype(sum_t)>(boids, i, deltaTime, params,
+                                                                                            &attrs);
+    });
+}
+
+// Helper function to process a batch of boids
+void update_boids_batch(BoidVector& boids, int start_idx, int end_idx, float deltaTime,
+                        const BoidParams& params) {
+    update_range(boids, start_idx, end_idx, deltaTime, params, nullptr);
+}
+
+void update_boids_parallel(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params) {
+    unsigned int num_threads = pool.size();
+
+    // Calculate batch size for each thread
+    int batch_size = boids.size() / num_threads;
+
+    pool.run([&](unsigned int i) {
+        int start_idx = i * batch_size;
+        int end_idx = (i == num_threads - 1) ? boids.size() : (i + 1) * batch_size;
+
+        update_boids_batch(boids, start_idx, end_idx, deltaTime, params);
+    });
+}
+
+void update_boids_parallel(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params,
+                           const BoidAttributes& attrs) {
+    if (attrs.empty()) {
+        update_boids_parallel(pool, boids, deltaTime, params);
+        return;
+    }
+    unsigned int num_threads = pool.size();
+    int batch_size = boids.size() / num_threads;
+
+    pool.run([&](unsigned int t) {
+        int start_idx = t * batch_size;
+        int end_idx = (t == num_threads - 1) ? boids.size() : (t + 1) * batch_size;
+        update_range(boids, start_idx, end_idx, deltaTime, params, &attrs);
+    });
+}
+
+void update_boids_parallel(BoidVector& boids, float deltaTime) {
+    static WorkerPool pool(NUM_THREADS);
+    update_boids_parallel(pool, boids, deltaTime);
+}
+
+void update_boids_parallel_spawn(BoidVector& boids, float deltaTime) {
+    std::vector<std::thread> threads;
+    
+    // Calculate batch size for each thread
+    int batch_size = boids.size() / NUM_THREADS;
+    
+    // Create and launch threads
+    for (unsigned int i = 0; i < NUM_THREADS; i++) {
+        int start_idx = i * batch_size;
+        int end_idx = (i == NUM_THREADS - 1) ? boids.size() : (i + 1) * batch_size;
+        
+        threads.emplace_back(update_boids_batch, std::ref(boids), start_idx, end_idx, deltaTime, std::cref(DEFAULT_PARAMS));
+    }
+    
+    // Join all threads
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
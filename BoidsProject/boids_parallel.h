@@ -0,0 +1,164 @@
+//
+// Simulation parameters and update kernels shared by the parallel targets.
+//
+
+#ifndef BOIDS_PARALLEL_H
+#define BOIDS_PARALLEL_H
+
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "worker_pool.h"
+
+#define NUM_BOIDS 200
+#define WIDTH 800
+#define HEIGHT 600
+
+#define VISUAL_RANGE 75
+#define PROTECTED_RANGE 20
+
+#define CENTERING_FACTOR 0.005f
+#define AVOID_FACTOR 0.05f
+#define MATCHING_FACTOR 0.05f
+#define TURN_FACTOR 1.0f
+
+#define MIN_SPEED 10.0f
+#define MAX_SPEED 40.0f
+
+#define MAX_BIAS 0.25f
+#define BIAS_INCREMENT 0.005f
+
+// Degrees of the vision cone centred on the heading, 360 sees all around
+#define FIELD_OF_VIEW 360.0f
+
+// Neighbours a boid samples at most on the grid kernels, 0 for all of them
+#define MAX_NEIGHBORS 0
+
+// Seconds ahead the time-to-collision rule looks, 0 turns it off
+#define TTC_HORIZON 0.0f
+// Velocity change per second away from an imminent collision
+#define TTC_FACTOR 300.0f
+// Distance at which two boids count as colliding, their body size
+#define COLLISION_RADIUS 5.0f
+
+// How the neighbour kernels add up their neighbours (boid_rules.h)
+#define ACCUMULATE_FLOAT 0
+#define ACCUMULATE_DOUBLE 1
+#define ACCUMULATE_KAHAN 2 // float with compensated summation
+#define ACCUMULATOR ACCUMULATE_FLOAT
+
+// Determine number of threads based on available hardware
+const unsigned int NUM_THREADS = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+struct Boid {
+    float x, y;
+    float vx, vy;
+    float biasval;
+    int scout_group; // 0: no bias, 1: right, 2: left
+};
+
+// Grows a vector without value-initialising the new elements. For a plain
+// record like Boid that means they are left unwritten, so a parallel fill
+// after resize() is the first touch of their pages and places them on the
+// threads that use them.
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    DefaultInitAllocator() = default;
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// The state of a simulation; resize() leaves new boids for the caller to fill
+using BoidVector = std::vector<Boid, DefaultInitAllocator<Boid>>;
+
+// Runtime copy of the tunables above, for front ends that change them on the fly
+struct BoidParams {
+    float width = WIDTH;
+    float height = HEIGHT;
+    float visual_range = VISUAL_RANGE;
+    float protected_range = PROTECTED_RANGE;
+    float centering_factor = CENTERING_FACTOR;
+    float avoid_factor = AVOID_FACTOR;
+    float matching_factor = MATCHING_FACTOR;
+    float turn_factor = TURN_FACTOR;
+    float min_speed = MIN_SPEED;
+    float max_speed = MAX_SPEED;
+    float max_bias = MAX_BIAS;
+    float bias_increment = BIAS_INCREMENT;
+    float field_of_view = FIELD_OF_VIEW;
+    int max_neighbors = MAX_NEIGHBORS;
+    float ttc_horizon = TTC_HORIZON;
+    float ttc_factor = TTC_FACTOR;
+    float collision_radius = COLLISION_RADIUS;
+    int accumulator = ACCUMULATOR;
+};
+
+inline const BoidParams DEFAULT_PARAMS{};
+
+// Optional per-boid speed limits and visual ranges, one array per attribute
+// indexed like the boids. Left empty, every boid uses BoidParams and the
+// kernels run their uniform specialisation.
+struct BoidAttributes {
+    // Default-init like BoidVector, so resize_unset() writes nothing
+    using Values = std::vector<float, DefaultInitAllocator<float>>;
+    Values visual_range;
+    Values min_speed;
+    Values max_speed;
+
+    bool empty() const { return visual_range.empty(); }
+    size_t size() const { return visual_range.size(); }
+    void clear() { visual_range.clear(); min_speed.clear(); max_speed.clear(); }
+
+    // New entries take the values of params
+    void resize(size_t count, const BoidParams& params);
+    // New entries are left unwritten, for a caller that fills every one
+    void resize_unset(size_t count);
+    void push_back(const BoidParams& params);
+    // Moves the last entry into slot i, mirroring how boids are removed
+    void remove(size_t i);
+
+    // Largest range any boid looks, what a neighbour grid has to be sized for
+    float max_visual_range(const BoidParams& params) const;
+};
+
+float randf(float min, float max);
+float clamp(float value, float min, float max);
+
+// Updates one boid and returns its neighbour count, the work it cost
+int update_boid(BoidVector& boids, int i, float deltaTime, const BoidParams& params = DEFAULT_PARAMS);
+int update_boid(BoidVector& boids, int i, float deltaTime, const BoidParams& params,
+                const BoidAttributes& attrs);
+
+// Helper function to process a batch of boids
+void update_boids_batch(BoidVector& boids, int start_idx, int end_idx, float deltaTime,
+                        const BoidParams& params = DEFAULT_PARAMS);
+
+// Splits the boids in equal batches over the threads of the pool
+void update_boids_parallel(WorkerPool& pool, BoidVector& boids, float deltaTime,
+                           const BoidParams& params = DEFAULT_PARAMS);
+// Same with per-boid attributes, falling back to the uniform kernel when attrs is empty
+void update_boids_parallel(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params,
+                           const BoidAttributes& attrs);
+// Same, on a pool of NUM_THREADS threads created on first use
+void update_boids_parallel(BoidVector& boids, float deltaTime);
+// Original version that spawns and joins NUM_THREADS threads every step
+void update_boids_parallel_spawn(BoidVector& boids, float deltaTime);
+
+#endif //BOIDS_PARALLEL_H
@@ -0,0 +1,92 @@
+// Python bindings over BoidsWorld. The state is handed out as NumPy views
+// straight into the boid array: no copy, and writes go to the simulation.
+// The views stay valid until the population outgrows capacity(), so call
+// reserve() before spawning if you keep them around. Worlds with emitters
+// or absorbers swap buffers whenever boids come or go; fetch fresh views
+// after step() there.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include "boids_world.h"
+
+namespace py = pybind11;
+
+// Strided view of one Boid field, kept alive by a reference to the world
+template <typename T>
+static py::array_t<T> field_view(BoidsWorld& world, py::object owner, size_t offset) {
+    auto* base = reinterpret_cast<char*>(world.boids().data()) + offset;
+    return py::array_t<T>({static_cast<py::ssize_t>(world.size())},
+                          {static_cast<py::ssize_t>(sizeof(Boid))},
+                          reinterpret_cast<T*>(base), owner);
+}
+
+PYBIND11_MODULE(pyboids, m) {
+    m.doc() = "Parallel boids simulation engine";
+
+    py::class_<BoidParams>(m, "Params")
+        .def(py::init<>())
+        .def_readwrite("width", &BoidParams::width)
+        .def_readwrite("height", &BoidParams::height)
+        .def_readwrite("visual_range", &BoidParams::visual_range)
+        .def_readwrite("protected_range", &BoidParams::protected_range)
+        .def_readwrite("centering_factor", &BoidParams::centering_factor)
+        .def_readwrite("avoid_factor", &BoidParams::avoid_factor)
+        .def_readwrite("matching_factor", &BoidParams::matching_factor)
+        .def_readwrite("turn_factor", &BoidParams::turn_factor)
+        .def_readwrite("min_speed", &BoidParams::min_speed)
+        .def_readwrite("max_speed", &BoidParams::max_speed)
+        .def_readwrite("max_bias", &BoidParams::max_bias)
+        .def_readwrite("bias_increment", &BoidParams::bias_increment)
+        .def_readwrite("field_of_view", &BoidParams::field_of_view)
+        .def_readwrite("max_neighbors", &BoidParams::max_neighbors)
+        .def_readwrite("ttc_horizon", &BoidParams::ttc_horizon)
+        .def_readwrite("ttc_factor", &BoidParams::ttc_factor)
+        .def_readwrite("collision_radius", &BoidParams::collision_radius)
+        .def_readwrite("accumulator", &BoidParams::accumulator);
+
+    py::enum_<InitialLayout>(m, "Layout")
+        .value("uniform", InitialLayout::Uniform)
+        .value("clusters", InitialLayout::Clusters)
+        .value("lattice", InitialLayout::Lattice)
+        .value("ring", InitialLayout::Ring)
+        .value("flocks", InitialLayout::Flocks);
+
+    py::class_<BoidsWorld>(m, "World")
+        .def(py::init<const BoidParams&, unsigned int>(), py::arg("params") = BoidParams(),
+             py::arg("num_threads") = NUM_THREADS)
+        // The layout overload goes first: an enum with __index__ would also pass for the int count
+        .def("populate", py::overload_cast<InitialLayout, size_t, uint64_t>(&BoidsWorld::populate),
+             py::arg("layout"), py::arg("count"), py::arg("seed") = 42)
+        .def("populate", py::overload_cast<int, unsigned int>(&BoidsWorld::populate), py::arg("count"),
+             py::arg("seed") = 42)
+        .def("spawn", &BoidsWorld::spawn, py::arg("x"), py::arg("y"), py::arg("vx") = 0.0f, py::arg("vy") = 0.0f,
+             py::arg("scout_group") = 0)
+        .def("remove", &BoidsWorld::remove)
+        .def("reserve", &BoidsWorld::reserve)
+        // Other Python threads keep running while the pool steps the world
+        .def("step", &BoidsWorld::step, py::arg("steps") = 1, py::arg("dt") = 1.0f / 60.0f,
+             py::call_guard<py::gil_scoped_release>())
+        .def_property("params", &BoidsWorld::params, &BoidsWorld::set_params)
+        .def_property_readonly("num_threads", &BoidsWorld::num_threads)
+        .def_property_readonly("capacity", &BoidsWorld::capacity)
+        .def("__len__", &BoidsWorld::size)
+        .def_property_readonly("x", [](py::object self) {
+            return field_view<float>(self.cast<BoidsWorld&>(), self, offsetof(Boid, x));
+        })
+        .def_property_readonly("y", [](py::object self) {
+            return field_view<float>(self.cast<BoidsWorld&>(), self, offsetof(Boid, y));
+        })
+        .def_property_readonly("vx", [](py::object self) {
+            return field_view<float>(self.cast<BoidsWorld&>(), self, offsetof(Boid, vx));
+        })
+        .def_property_readonly("vy", [](py::object self) {
+            return field_view<float>(self.cast<BoidsWorld&>(), self, offsetof(Boid, vy));
+        })
+        .def_property_readonly("scout_group", [](py::object self) {
+            return field_view<int>(self.cast<BoidsWorld&>(), self, offsetof(Boid, scout_group));
+        });
+}
@@ -0,0 +1,123 @@
+// Headless run that streams its state to local viewers, and a minimal viewer.
+// Usage: BoidsServer serve <socket> [num_boids] [steps] [every_k_steps]
+//        BoidsServer watch <socket> [read_delay_ms]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "boids_world.h"
+#include "flight_recorder.h"
+#include "stream_server.h"
+
+#define SERVER_DT (1.0f / 60.0f)
+
+static int serve(const char* path, int num_boids, int steps, int every) {
+    StreamServer server(path);
+    if (!server.ok()) {
+        fprintf(stderr, "cannot listen on %s\n", path);
+        return 1;
+    }
+
+    BoidsWorld world;
+    world.populate(num_boids, 42);
+    printf("serving %d boids on %s every %d steps\n", num_boids, path, every);
+
+    // kill -USR1 <pid> or a slow step dumps the last seconds next to the socket
+    FlightRecorder flight(std::string(path) + "_flight", world.params());
+    FlightRecorder::install_signal_trigger();
+
+    double worst_publish = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 1; s <= steps; s++) {
+        auto step_start = std::chrono::steady_clock::now();
+        world.step(1, SERVER_DT);
+        flight.record(world.boids(), s, std::chrono::duration<double>(std::chrono::steady_clock::now() - step_start).count());
+        if (s % every == 0) {
+            auto t0 = std::chrono::steady_clock::now();
+            server.publish(world.boids(), world.params(), s);
+            worst_publish = std::max(worst_publish, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Give connected viewers a moment to drain the last frames
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int viewers = server.subscribers();
+    if (flight.dumps() > 0) printf("flight recorder dumped %d times, last %s\n", flight.dumps(), flight.last_dump().c_str());
+    server.stop();
+    SubscriberStats totals = server.totals();
+    printf("%d steps in %.3f s, %llu frames published, worst publish %.3f ms\n", steps, elapsed,
+           static_cast<unsigned long long>(server.frames_published()), worst_publish * 1e3);
+    printf("%d viewers at the end; frames sent %llu, dropped for slow viewers %llu\n", viewers,
+           static_cast<unsigned long long>(totals.frames_sent), static_cast<unsigned long long>(totals.frames_dropped));
+    return 0;
+}
+
+static bool read_all(int fd, void* buf, size_t len) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static int watch(const char* path, int delay_ms) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fprintf(stderr, "cannot connect to %s\n", path);
+        return 1;
+    }
+
+    StreamFrameHeader header;
+    std::vector<uint8_t> records;
+    uint64_t frames = 0, missed = 0, last_sequence = 0;
+    while (read_all(fd, &header, sizeof(header))) {
+        if (header.magic != STREAM_MAGIC || header.version != STREAM_VERSION) {
+            fprintf(stderr, "unexpected stream format\n");
+            break;
+        }
+        records.resize(static_cast<size_t>(header.count) * header.record_bytes);
+        if (!read_all(fd, records.data(), records.size())) break;
+
+        if (last_sequence != 0 && header.sequence > last_sequence + 1) missed += header.sequence - last_sequence - 1;
+        last_sequence = header.sequence;
+        frames++;
+
+        // Simulates a dashboard that takes a while to draw each frame
+        if (delay_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    close(fd);
+    printf("received %llu frames, missed %llu, last step %llu\n", static_cast<unsigned long long>(frames),
+           static_cast<unsigned long long>(missed), static_cast<unsigned long long>(header.step));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::string(argv[1]) == "serve") {
+        int num_boids = argc > 3 ? atoi(argv[3]) : 2000;
+        int steps = argc > 4 ? atoi(argv[4]) : 600;
+        int every = argc > 5 ? std::max(1, atoi(argv[5])) : 1;
+        return serve(argv[2], num_boids, steps, every);
+    }
+    if (argc >= 3 && std::string(argv[1]) == "watch") {
+        return watch(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+    }
+    fprintf(stderr, "usage: %s serve <socket> [num_boids] [steps] [every_k_steps]\n"
+                    "       %s watch <socket> [read_delay_ms]\n", argv[0], argv[0]);
+    return 1;
+}
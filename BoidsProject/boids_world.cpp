@@ -0,0 +1,152 @@
+#include "boids_world.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+BoidsWorld::BoidsWorld(const BoidParams& params, unsigned int num_threads) : params_(params), pool_(num_threads) {}
+
+void BoidsWorld::populate(int count, unsigned int seed) {
+    boids_.clear();
+    boids_.reserve(count);
+    srand(seed);
+    for (int i = 0; i < count; i++) {
+        Boid b;
+        b.x = randf(0, params_.width);
+        b.y = randf(0, params_.height);
+        b.vx = randf(-2, 2);
+        b.vy = randf(-2, 2);
+        b.biasval = 0.0f;
+        b.scout_group = (i < 10) ? 1 : (i < 20) ? 2 : 0;
+        boids_.push_back(b);
+    }
+    reset_attributes();
+    if (cell_positions_) cells_.capture(pool_, boids_);
+    if (info_) info_->start(boids_);
+}
+
+void BoidsWorld::populate(InitialLayout layout, size_t count, uint64_t seed) {
+    generate_boids(pool_, boids_, layout, count, seed, params_);
+    reset_attributes();
+    if (cell_positions_) cells_.capture(pool_, boids_);
+    if (info_) info_->start(boids_);
+}
+
+bool BoidsWorld::load(const std::string& path) {
+    bool ok = load_state(pool_, path, boids_);
+    reset_attributes();
+    if (cell_positions_) cells_.capture(pool_, boids_);
+    if (info_) info_->start(boids_);
+    return ok;
+}
+
+void BoidsWorld::reset_attributes() {
+    if (attrs_.empty()) return;
+    attrs_.clear();
+    attrs_.resize(boids_.size(), params_);
+}
+
+int BoidsWorld::spawn(float x, float y, float vx, float vy, int scout_group) {
+    boids_.push_back({x, y, vx, vy, 0.0f, scout_group});
+    if (!attrs_.empty()) attrs_.push_back(params_);
+    if (info_) info_->add_sources(boids_, boids_.size() - 1);
+    return size() - 1;
+}
+
+void BoidsWorld::remove(int index) {
+    if (index < 0 || index >= size()) return;
+    boids_[index] = boids_.back();
+    boids_.pop_back();
+    if (!attrs_.empty()) attrs_.remove(index);
+    if (cell_positions_) cells_.remove(index);
+    if (info_) info_->moved(size(), index);
+}
+
+const UniformGrid& BoidsWorld::query_index(const UniformGrid*& index, float& slack, float cell_size) {
+    if (!index) {
+        // Only the brute-force kernel gets here; next to it the O(N) build does not show
+        query_index_.build(boids_, std::max(cell_size, 1.0f));
+        index = &query_index_;
+        slack = 0.0f;
+    }
+    return *index;
+}
+
+void BoidsWorld::set_information(std::unique_ptr<InformationSpread> info) {
+    info_ = std::move(info);
+    if (info_) info_->start(boids_);
+}
+
+void BoidsWorld::set_cell_positions(bool enabled) {
+    cell_positions_ = enabled;
+    if (enabled) cells_.capture(pool_, boids_);
+    else cells_ = CellPositions();
+}
+
+double BoidsWorld::position_x(int index) const {
+    if (cell_positions_ && static_cast<size_t>(index) < cells_.size()) return cell_world_x(cells_[index]);
+    return boids_[index].x;
+}
+
+double BoidsWorld::position_y(int index) const {
+    if (cell_positions_ && static_cast<size_t>(index) < cells_.size()) return cell_world_y(cells_[index]);
+    return boids_[index].y;
+}
+
+void BoidsWorld::set_position(int index, double x, double y) {
+    if (index < 0 || index >= size()) return;
+    if (cell_positions_) {
+        cells_.place(boids_, index, x, y);
+        return;
+    }
+    boids_[index].x = static_cast<float>(x);
+    boids_[index].y = static_cast<float>(y);
+}
+
+void BoidsWorld::set_grid_levels(unsigned int levels) {
+    grid_levels_ = levels;
+    if (levels > 0) grid_ = HierarchicalGrid(levels);
+}
+
+void BoidsWorld::step(int steps, float deltaTime) {
+    for (int s = 0; s < steps; s++) {
+        // Before the kernels, so the speed limits also hold against the wind
+        if (flow_) {
+            flow_->advance(deltaTime);
+            flow_->apply(pool_, boids_, deltaTime);
+        }
+        const UniformGrid* index = nullptr;
+        // A field too coarse for the visual range falls back to the grid kernel
+        if (pic_ && pic_->step(pool_, boids_, deltaTime, params_, attrs_)) {
+            index = &pic_->separation_grid();
+        } else if (cell_positions_) {
+            update_boids_cells(pool_, grid_, cells_, boids_, deltaTime, params_, attrs_);
+            index = &grid_.coarsest();
+        } else if (pic_ || grid_levels_ > 0 || params_.max_neighbors > 0) {
+            update_boids_grid(pool_, grid_, boids_, deltaTime, params_, attrs_);
+            index = &grid_.coarsest();
+        } else {
+            update_boids_parallel(pool_, boids_, deltaTime, params_, attrs_);
+        }
+
+        // Widen queries on the update's grid by how far a boid can have moved since
+        float slack = params_.max_speed;
+        if (!attrs_.empty()) slack = *std::max_element(attrs_.max_speed.begin(), attrs_.max_speed.end());
+        slack *= deltaTime;
+        if (!attractors_.empty() && !boids_.empty()) {
+            const UniformGrid& grid = query_index(index, slack, max_attractor_radius(attractors_));
+            apply_attractors(pool_, grid, slack, boids_, attractors_, deltaTime);
+        }
+        if (info_) {
+            info_->fire(boids_, deltaTime);
+            if (info_->has_frontier()) info_->broadcast(query_index(index, slack, info_->params().range), slack, boids_);
+        }
+
+        size_t before = boids_.size();
+        PopulationChange change = population_.update(pool_, boids_, deltaTime, &attrs_, params_,
+                                                     info_ || cell_positions_ ? &new_index_ : nullptr);
+        if (info_ && change.absorbed) info_->remap(new_index_);
+        // Emitted boids are picked up by the next sync
+        if (cell_positions_ && change.absorbed) cells_.remap(new_index_);
+        if (info_ && change.emitted) info_->add_sources(boids_, before - change.absorbed);
+    }
+}
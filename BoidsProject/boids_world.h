@@ -0,0 +1,127 @@
+//
+// Self-contained simulation engine for front ends that embed the boids
+// without a window: owns the state, the parameters and a worker pool.
+//
+
+#ifndef BOIDS_WORLD_H
+#define BOIDS_WORLD_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "attractors.h"
+#include "boids_parallel.h"
+#include "cell_position.h"
+#include "flow_field.h"
+#include "information.h"
+#include "initial_state.h"
+#include "neighbor_grid.h"
+#include "particle_in_cell.h"
+#include "population.h"
+
+class BoidsWorld {
+public:
+    explicit BoidsWorld(const BoidParams& params = BoidParams(), unsigned int num_threads = NUM_THREADS);
+
+    // Fills the world with count boids the way the windowed programs do,
+    // the first 10 biased right and the next 10 biased left
+    void populate(int count, unsigned int seed);
+    // Lays out count boids with the parallel generators of initial_state.h
+    void populate(InitialLayout layout, size_t count, uint64_t seed);
+    // Replaces the state with the boids of a checkpoint file, false if it could not be read
+    bool load(const std::string& path);
+
+    // Appends a boid and returns its index
+    int spawn(float x, float y, float vx, float vy, int scout_group);
+    // Removes boid index by moving the last boid into its slot
+    void remove(int index);
+    // Grows the storage up front so spawning does not move the state arrays
+    void reserve(int capacity) { population_.reserve(boids_, capacity); }
+
+    // Emitters and absorbers, applied after every update by step()
+    Population& population() { return population_; }
+
+    // Attractors and repellers, applied after every update by step(). They
+    // query the grid the update just used; only the brute-force kernel has
+    // none, and there a grid is built for them.
+    std::vector<Attractor>& attractors() { return attractors_; }
+
+    // Scout information relay, run after every update while set. Setting
+    // one makes the boids that currently have a scout group its sources;
+    // spawned and emitted boids with a group become sources too.
+    void set_information(std::unique_ptr<InformationSpread> info);
+    InformationSpread* information() const { return info_.get(); }
+
+    // Per-boid speed limits and visual ranges, kept in step with spawn,
+    // remove and the population. Empty until enable_attributes() fills
+    // them with the current params.
+    void enable_attributes() { attrs_.resize(boids_.size(), params_); }
+    BoidAttributes& attributes() { return attrs_; }
+
+    // 0 keeps the brute-force kernel, n > 0 switches step() to a grid with up
+    // to n levels, 1 being a single grid sized for the longest visual range.
+    // A max_neighbors cap in the params needs a grid and gets one regardless.
+    void set_grid_levels(unsigned int levels);
+    unsigned int grid_levels() const { return grid_levels_; }
+
+    // A particle-in-cell engine replaces the neighbour kernels in step()
+    // while set; nullptr goes back to them
+    void set_particle_in_cell(std::unique_ptr<ParticleInCell> engine) { pic_ = std::move(engine); }
+    ParticleInCell* particle_in_cell() const { return pic_.get(); }
+
+    // Keeps the positions as cells and offsets (cell_position.h) for worlds
+    // too large for float coordinates. step() then always runs the grid
+    // kernel, even with no levels set; x and y of the boids
+    // become float copies that front ends may still read and write. The
+    // particle-in-cell engine moves only the copies and loses the precision.
+    void set_cell_positions(bool enabled);
+    bool cell_positions() const { return cell_positions_; }
+    // Exact position of boid index, also without cell positions
+    double position_x(int index) const;
+    double position_y(int index) const;
+    // Moves boid index to (x, y), kept exactly with cell positions
+    void set_position(int index, double x, double y);
+
+    // A flow field pushes the boids along its wind before every update
+    // while set; nullptr turns it off
+    void set_flow_field(std::unique_ptr<FlowField> flow) { flow_ = std::move(flow); }
+    FlowField* flow_field() const { return flow_.get(); }
+
+    void step(int steps, float deltaTime);
+
+    const BoidParams& params() const { return params_; }
+    void set_params(const BoidParams& params) { params_ = params; }
+
+    int size() const { return static_cast<int>(boids_.size()); }
+    int capacity() const { return static_cast<int>(boids_.capacity()); }
+    BoidVector& boids() { return boids_; }
+    const BoidVector& boids() const { return boids_; }
+    unsigned int num_threads() const { return pool_.size(); }
+
+private:
+    // A fresh state starts every enabled attribute from params_
+    void reset_attributes();
+    // The grid this step's update binned the boids in, slack away from where
+    // they are now; without one, a grid of cell_size is built and used from then on
+    const UniformGrid& query_index(const UniformGrid*& index, float& slack, float cell_size);
+
+    BoidParams params_;
+    BoidVector boids_;
+    BoidAttributes attrs_;
+    Population population_;
+    std::vector<Attractor> attractors_;
+    std::unique_ptr<InformationSpread> info_;
+    std::vector<int> new_index_;
+    bool cell_positions_ = false;
+    CellPositions cells_;
+    UniformGrid query_index_;
+    unsigned int grid_levels_ = 0;
+    HierarchicalGrid grid_;
+    std::unique_ptr<ParticleInCell> pic_;
+    std::unique_ptr<FlowField> flow_;
+    WorkerPool pool_;
+};
+
+#endif //BOIDS_WORLD_H
@@ -0,0 +1,166 @@
+#include "cell_position.h"
+
+#include <cmath>
+
+#include "boid_rules.h"
+
+// Moves whole cells out of offset until it lies in [0, POSITION_CELL_SIZE)
+static inline void normalize(int32_t& cell, float& offset) {
+    if (offset >= 0.0f && offset < POSITION_CELL_SIZE) return;
+    float shift = std::floor(offset / POSITION_CELL_SIZE);
+    cell += static_cast<int32_t>(shift);
+    offset -= shift * POSITION_CELL_SIZE;
+    // A tiny negative offset rounds up to the full cell
+    if (offset >= POSITION_CELL_SIZE) {
+        cell++;
+        offset -= POSITION_CELL_SIZE;
+    }
+}
+
+CellPosition to_cell_position(double x, double y) {
+    CellPosition p;
+    double cx = std::floor(x / POSITION_CELL_SIZE);
+    double cy = std::floor(y / POSITION_CELL_SIZE);
+    p.cx = static_cast<int32_t>(cx);
+    p.cy = static_cast<int32_t>(cy);
+    p.ox = static_cast<float>(x - cx * POSITION_CELL_SIZE);
+    p.oy = static_cast<float>(y - cy * POSITION_CELL_SIZE);
+    normalize(p.cx, p.ox);
+    normalize(p.cy, p.oy);
+    return p;
+}
+
+// Splits [0, count) over the pool the way the kernels do
+template <typename Fn>
+static void for_each_parallel(WorkerPool& pool, size_t count, Fn&& fn) {
+    unsigned int num_threads = pool.size();
+    size_t batch_size = count / num_threads;
+    pool.run([&](unsigned int t) {
+        size_t start_idx = t * batch_size;
+        size_t end_idx = (t == num_threads - 1) ? count : (t + 1) * batch_size;
+        for (size_t i = start_idx; i < end_idx; i++) fn(i);
+    });
+}
+
+void CellPositions::capture(WorkerPool& pool, const BoidVector& boids) {
+    cells_.resize(boids.size());
+    for_each_parallel(pool, boids.size(), [&](size_t i) {
+        cells_[i] = to_cell_position(boids[i].x, boids[i].y);
+    });
+}
+
+void CellPositions::sync(WorkerPool& pool, const BoidVector& boids) {
+    cells_.resize(boids.size());
+    for_each_parallel(pool, boids.size(), [&](size_t i) {
+        const Boid& b = boids[i];
+        CellPosition& p = cells_[i];
+        // Appended cells start at the origin, which only matches a boid that is there
+        if (static_cast<float>(cell_world_x(p)) != b.x || static_cast<float>(cell_world_y(p)) != b.y) {
+            p = to_cell_position(b.x, b.y);
+        }
+    });
+}
+
+void CellPositions::remove(size_t index) {
+    if (index >= cells_.size()) return;
+    cells_[index] = cells_.back();
+    cells_.pop_back();
+}
+
+void CellPositions::remap(const std::vector<int>& new_index) {
+    size_t kept = 0;
+    for (size_t i = 0; i < cells_.size() && i < new_index.size(); i++) {
+        // Survivors keep their order, so moving down in place never overwrites one still to come
+        if (new_index[i] >= 0) {
+            cells_[new_index[i]] = cells_[i];
+            kept++;
+        }
+    }
+    cells_.resize(kept);
+}
+
+void CellPositions::place(BoidVector& boids, size_t index, double x, double y) {
+    if (cells_.size() < boids.size()) cells_.resize(boids.size());
+    cells_[index] = to_cell_position(x, y);
+    boids[index].x = static_cast<float>(x);
+    boids[index].y = static_cast<float>(y);
+}
+
+template <bool PerBoid, bool Fov, bool Ttc, typename Sum>
+static void steer_slice_cells(const HierarchicalGrid& grid, const std::vector<CellPosition>& cells,
+                              BoidVector& boids, int start_idx, int end_idx, float deltaTime,
+                              const BoidParams& params, const BoidAttributes& attrs) {
+    const Lookahead ahead = lookahead(params);
+    for (int i = start_idx; i < end_idx; i++) {
+        auto& boid = boids[i];
+        const float visual_range = PerBoid ? attrs.visual_range[i] : params.visual_range;
+        const float min_speed = PerBoid ? attrs.min_speed[i] : params.min_speed;
+        const float max_speed = PerBoid ? attrs.max_speed[i] : params.max_speed;
+        const ViewCone cone = Fov ? view_cone(boid, params) : ViewCone();
+        const CellPosition here = cells[i];
+        NeighborSums<Sum> sums;
+
+        // The boid at the origin of its own frame
+        Boid self = boid;
+        self.x = 0.0f;
+        self.y = 0.0f;
+
+        auto visit = [&](int j) {
+            if (j == i) return;
+            // Cell differences times a power of two are exact, the offsets
+            // differ by less than a cell: no large coordinate is ever formed
+            Boid other = boids[j];
+            other.x = static_cast<float>(cells[j].cx - here.cx) * POSITION_CELL_SIZE + (cells[j].ox - here.ox);
+            other.y = static_cast<float>(cells[j].cy - here.cy) * POSITION_CELL_SIZE + (cells[j].oy - here.oy);
+            accumulate_neighbor<Fov, Ttc>(self, other, visual_range, params.protected_range, sums, cone, ahead);
+        };
+        const UniformGrid& level = grid.level_for(visual_range);
+        if (params.max_neighbors > 0) {
+            int stride = level.for_each_near_sampled(boid.x, boid.y, params.max_neighbors * SAMPLE_CANDIDATES_PER_NEIGHBOR,
+                                                     static_cast<unsigned int>(i), visit);
+            sums.close_dx *= stride;
+            sums.close_dy *= stride;
+            sums.avoid_dx *= stride;
+            sums.avoid_dy *= stride;
+        } else {
+            level.for_each_near(boid.x, boid.y, visit);
+        }
+
+        steer_velocity(self, sums, boid.x, boid.y, deltaTime, params, min_speed, max_speed);
+        boid.vx = self.vx;
+        boid.vy = self.vy;
+        boid.biasval = self.biasval;
+    }
+}
+
+void update_boids_cells(WorkerPool& pool, HierarchicalGrid& grid, CellPositions& cells, BoidVector& boids,
+                        float deltaTime, const BoidParams& params, const BoidAttributes& attrs) {
+    cells.sync(pool, boids);
+    grid.build(boids, deltaTime, params, attrs);
+
+    unsigned int num_threads = pool.size();
+    int batch_size = boids.size() / num_threads;
+    const std::vector<CellPosition>& positions = cells.cells();
+
+    pool.run([&](unsigned int t) {
+        int start_idx = t * batch_size;
+        int end_idx = (t == num_threads - 1) ? boids.size() : (t + 1) * batch_size;
+        dispatch_kernel(!attrs.empty(), fov_enabled(params), ttc_enabled(params), params.accumulator,
+                        [&](auto per_boid_t, auto fov_t, auto ttc_t, auto sum_t) {
+            steer_slice_cells<per_boid_t.value, fov_t.value, ttc_t.value, decltype(sum_t)>(
+                grid, positions, boids, start_idx, end_idx, deltaTime, params, attrs);
+        });
+    });
+
+    std::vector<CellPosition>& moving = cells.cells();
+    for_each_parallel(pool, boids.size(), [&](size_t i) {
+        Boid& b = boids[i];
+        CellPosition& p = moving[i];
+        p.ox += b.vx * deltaTime;
+        p.oy += b.vy * deltaTime;
+        normalize(p.cx, p.ox);
+        normalize(p.cy, p.oy);
+        b.x = static_cast<float>(cell_world_x(p));
+        b.y = static_cast<float>(cell_world_y(p));
+    });
+}
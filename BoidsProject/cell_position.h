@@ -0,0 +1,72 @@
+//
+// Positions kept as an integer cell and a float offset inside it, so boids
+// far from the origin keep the precision they have near it without moving
+// the state or the kernels to double.
+//
+
+#ifndef CELL_POSITION_H
+#define CELL_POSITION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "neighbor_grid.h"
+
+// Side of a position cell. A power of two, so cell corners are exact in
+// float and an offset below it has the precision of a coordinate below 1024.
+#define POSITION_CELL_SIZE 1024.0f
+
+struct CellPosition {
+    int32_t cx = 0, cy = 0;
+    float ox = 0.0f, oy = 0.0f; // in [0, POSITION_CELL_SIZE)
+};
+
+CellPosition to_cell_position(double x, double y);
+
+inline double cell_world_x(const CellPosition& p) {
+    return static_cast<double>(p.cx) * POSITION_CELL_SIZE + p.ox;
+}
+
+inline double cell_world_y(const CellPosition& p) {
+    return static_cast<double>(p.cy) * POSITION_CELL_SIZE + p.oy;
+}
+
+// The exact positions of a state whose Boid x and y are float copies of
+// them, refreshed after every update. Everything that only reads or bins
+// positions keeps working on the copies; a copy that no longer matches
+// its cell was written from outside and is taken as the new position.
+class CellPositions {
+public:
+    // Takes every position from the float x and y of the boids
+    void capture(WorkerPool& pool, const BoidVector& boids);
+    // Follows boids that were appended or had their x or y written since
+    // the last update, and drops the cells of boids that are gone
+    void sync(WorkerPool& pool, const BoidVector& boids);
+
+    // Same moves as BoidsWorld::remove and the population compaction
+    void remove(size_t index);
+    void remap(const std::vector<int>& new_index);
+
+    // Places boid index at a position that float x and y cannot hold
+    void place(BoidVector& boids, size_t index, double x, double y);
+
+    size_t size() const { return cells_.size(); }
+    const CellPosition& operator[](size_t index) const { return cells_[index]; }
+    std::vector<CellPosition>& cells() { return cells_; }
+
+private:
+    std::vector<CellPosition> cells_;
+};
+
+// update_boids_grid on cell positions. The grid still bins the float
+// copies, whose rounding is far below the slack of its cells. Every boid
+// sees its neighbours in a frame centred on itself, built from the
+// differences of cells and offsets, so the neighbour kernel stays float.
+// Velocities are updated first and all boids moved afterwards, so a boid
+// never sees a neighbour halfway through crossing into another cell.
+void update_boids_cells(WorkerPool& pool, HierarchicalGrid& grid, CellPositions& cells, BoidVector& boids,
+                        float deltaTime, const BoidParams& params = DEFAULT_PARAMS,
+                        const BoidAttributes& attrs = BoidAttributes());
+
+#endif //CELL_POSITION_H
@@ -0,0 +1,12 @@
+#include "checkpoint.h"
+
+bool write_checkpoint(TrajectorySink& sink, const BoidVector& boids, uint64_t step) {
+    CheckpointHeader header;
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.step = step;
+    header.count = boids.size();
+    header.record_bytes = sizeof(Boid);
+    header.reserved = 0;
+    return sink.write(&header, sizeof(header)) && sink.write(boids.data(), boids.size() * sizeof(Boid));
+}
@@ -0,0 +1,29 @@
+//
+// Full-precision state snapshots, written through any TrajectorySink.
+//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "trajectory.h"
+
+#define CHECKPOINT_MAGIC 0x504b4342u // "BCKP"
+#define CHECKPOINT_VERSION 1
+
+// Header followed by count raw Boid records of record_bytes each
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t step;
+    uint64_t count;
+    uint32_t record_bytes;
+    uint32_t reserved;
+};
+
+bool write_checkpoint(TrajectorySink& sink, const BoidVector& boids, uint64_t step);
+
+#endif //CHECKPOINT_H
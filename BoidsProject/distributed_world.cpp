@@ -0,0 +1,382 @@
+#include "distributed_world.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#define HALO_TAG 7601
+
+static double now() {
+    return MPI_Wtime();
+}
+
+DistributedWorld::DistributedWorld(MPI_Comm comm, int total_boids, unsigned int seed) : comm_(comm) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &size_);
+
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size_, 2, dims);
+    const float inf = std::numeric_limits<float>::infinity();
+    for (int r = 0; r < size_; r++) {
+        int tx = r % dims[0], ty = r / dims[0];
+        Domain d;
+        d.x0 = tx == 0 ? -inf : static_cast<float>(WIDTH) * tx / dims[0];
+        d.x1 = tx == dims[0] - 1 ? inf : static_cast<float>(WIDTH) * (tx + 1) / dims[0];
+        d.y0 = ty == 0 ? -inf : static_cast<float>(HEIGHT) * ty / dims[1];
+        d.y1 = ty == dims[1] - 1 ? inf : static_cast<float>(HEIGHT) * (ty + 1) / dims[1];
+        domains_.push_back(d);
+    }
+
+    srand(seed);
+    for (int i = 0; i < total_boids; i++) {
+        Boid b;
+        b.x = randf(0, WIDTH);
+        b.y = randf(0, HEIGHT);
+        b.vx = randf(-2, 2);
+        b.vy = randf(-2, 2);
+        b.biasval = 0.0f;
+        b.scout_group = (i < 10) ? 1 : (i < 20) ? 2 : 0;
+        if (domains_[rank_].contains(b.x, b.y)) boids_.push_back(b);
+    }
+    num_owned_ = static_cast<int>(boids_.size());
+    work_.assign(num_owned_, 0);
+
+    send_.resize(size_);
+    recv_.resize(size_);
+    send_counts_.assign(size_, 0);
+    recv_counts_.assign(size_, 0);
+}
+
+int DistributedWorld::owner_of(float x, float y) const {
+    for (int r = 0; r < size_; r++) {
+        if (domains_[r].contains(x, y)) return r;
+    }
+    return rank_; // NaN positions stay where they are
+}
+
+// A boid near no other domain needs no ghosts and is nobody's ghost
+void DistributedWorld::classify() {
+    interior_.clear();
+    border_.clear();
+    for (auto& list : send_) list.clear();
+
+    for (int i = 0; i < num_owned_; i++) {
+        const Boid& b = boids_[i];
+        bool is_border = false;
+        for (int r = 0; r < size_; r++) {
+            if (r == rank_ || !domains_[r].near(b.x, b.y, VISUAL_RANGE)) continue;
+            send_[r].push_back(b);
+            is_border = true;
+        }
+        (is_border ? border_ : interior_).push_back(i);
+    }
+}
+
+void DistributedWorld::post_halo() {
+    data_requests_.clear();
+    receives_posted_ = false;
+    halo_done_ = false;
+    halo_posted_at_ = now();
+
+    for (int r = 0; r < size_; r++) send_counts_[r] = static_cast<int>(send_[r].size());
+    MPI_Ialltoall(send_counts_.data(), 1, MPI_INT, recv_counts_.data(), 1, MPI_INT, comm_, &count_request_);
+
+    for (int r = 0; r < size_; r++) {
+        if (send_counts_[r] == 0) continue;
+        data_requests_.emplace_back();
+        MPI_Isend(send_[r].data(), send_counts_[r] * static_cast<int>(sizeof(Boid)), MPI_BYTE, r, HALO_TAG, comm_,
+                  &data_requests_.back());
+    }
+}
+
+// Only called from the thread that owns MPI (pool thread 0)
+void DistributedWorld::progress_halo() {
+    if (halo_done_) return;
+    int flag = 0;
+    if (!receives_posted_) {
+        MPI_Test(&count_request_, &flag, MPI_STATUS_IGNORE);
+        if (!flag) return;
+        for (int r = 0; r < size_; r++) {
+            recv_[r].resize(recv_counts_[r]);
+            if (recv_counts_[r] == 0) continue;
+            data_requests_.emplace_back();
+            MPI_Irecv(recv_[r].data(), recv_counts_[r] * static_cast<int>(sizeof(Boid)), MPI_BYTE, r, HALO_TAG, comm_,
+                      &data_requests_.back());
+        }
+        receives_posted_ = true;
+    }
+    MPI_Testall(static_cast<int>(data_requests_.size()), data_requests_.data(), &flag, MPI_STATUSES_IGNORE);
+    if (flag) {
+        halo_done_ = true;
+        halo_done_at_ = now();
+    }
+}
+
+void DistributedWorld::finish_halo() {
+    double wait_start = now();
+    while (!halo_done_) {
+        progress_halo();
+    }
+    stats_.exposed_seconds += now() - wait_start;
+    stats_.comm_seconds += halo_done_at_ - halo_posted_at_;
+
+    // Ghosts go behind the owned boids so update_boid sees them as neighbours
+    for (int r = 0; r < size_; r++) {
+        boids_.insert(boids_.end(), recv_[r].begin(), recv_[r].end());
+        stats_.ghosts_received += recv_counts_[r];
+    }
+}
+
+void DistributedWorld::step(WorkerPool& pool, float deltaTime) {
+    double step_start = now();
+    classify();
+    post_halo();
+
+    // Interior boids are dealt out in chunks; thread 0 drives MPI between its chunks
+    next_chunk_.store(0, std::memory_order_relaxed);
+    int num_interior = static_cast<int>(interior_.size());
+    pool.run([&](unsigned int t) {
+        while (true) {
+            int begin = next_chunk_.fetch_add(INTERIOR_CHUNK, std::memory_order_relaxed);
+            if (begin >= num_interior) break;
+            int end = std::min(begin + INTERIOR_CHUNK, num_interior);
+            for (int k = begin; k < end; k++) {
+                work_[interior_[k]] = update_boid(boids_, interior_[k], deltaTime);
+            }
+            if (t == 0) progress_halo();
+        }
+    });
+    double interior_end = now();
+    stats_.interior_seconds += interior_end - step_start;
+
+    finish_halo();
+
+    int num_border = static_cast<int>(border_.size());
+    unsigned int num_threads = pool.size();
+    pool.run([&](unsigned int t) {
+        int begin = static_cast<int>(static_cast<long>(num_border) * t / num_threads);
+        int end = static_cast<int>(static_cast<long>(num_border) * (t + 1) / num_threads);
+        for (int k = begin; k < end; k++) {
+            work_[border_[k]] = update_boid(boids_, border_[k], deltaTime);
+        }
+    });
+    boids_.resize(num_owned_);
+    double step_end = now();
+    stats_.border_seconds += step_end - interior_end;
+    stats_.step_seconds += step_end - step_start;
+    stats_.steps++;
+
+    migrate();
+}
+
+void DistributedWorld::migrate() {
+    std::vector<std::vector<Migrant>> outgoing(size_);
+    int kept = 0;
+    for (int i = 0; i < num_owned_; i++) {
+        int owner = owner_of(boids_[i].x, boids_[i].y);
+        if (owner == rank_) {
+            boids_[kept] = boids_[i];
+            work_[kept++] = work_[i];
+        } else {
+            outgoing[owner].push_back({boids_[i], work_[i]});
+        }
+    }
+
+    // Counts first, then every rank's leavers in a single alltoallv
+    std::vector<int> send_bytes(size_), recv_bytes(size_), send_displs(size_), recv_displs(size_);
+    std::vector<Migrant> packed;
+    for (int r = 0; r < size_; r++) {
+        send_displs[r] = static_cast<int>(packed.size() * sizeof(Migrant));
+        send_bytes[r] = static_cast<int>(outgoing[r].size() * sizeof(Migrant));
+        packed.insert(packed.end(), outgoing[r].begin(), outgoing[r].end());
+    }
+    MPI_Alltoall(send_bytes.data(), 1, MPI_INT, recv_bytes.data(), 1, MPI_INT, comm_);
+    int total_recv = 0;
+    for (int r = 0; r < size_; r++) {
+        recv_displs[r] = total_recv;
+        total_recv += recv_bytes[r];
+    }
+    std::vector<Migrant> arrived(total_recv / sizeof(Migrant));
+    MPI_Alltoallv(packed.data(), send_bytes.data(), send_displs.data(), MPI_BYTE,
+                  arrived.data(), recv_bytes.data(), recv_displs.data(), MPI_BYTE, comm_);
+
+    boids_.resize(kept);
+    work_.resize(kept);
+    for (const auto& m : arrived) {
+        boids_.push_back(m.boid);
+        work_.push_back(m.work);
+    }
+    num_owned_ = static_cast<int>(boids_.size());
+}
+
+// Heaviest rank over the average rank, for a given work per rank
+static double imbalance_of(const std::vector<double>& rank_work) {
+    double total = 0.0, heaviest = 0.0;
+    for (double w : rank_work) {
+        total += w;
+        heaviest = std::max(heaviest, w);
+    }
+    return total > 0.0 ? heaviest / (total / rank_work.size()) : 1.0;
+}
+
+// Brute-force work of every rank if domains owned the boids: each owned
+// boid tests all owned and ghost boids of its rank and accumulates its
+// neighbours. mean_pass gets the average length of one such pass.
+std::vector<double> DistributedWorld::work_per_rank(const std::vector<Domain>& domains, double* mean_pass) const {
+    // Owned boids, ghosts and neighbour counts of every rank
+    std::vector<double> local(3 * size_, 0.0), global(3 * size_, 0.0);
+    for (int i = 0; i < num_owned_; i++) {
+        const Boid& b = boids_[i];
+        int owner = rank_;
+        for (int r = 0; r < size_; r++) {
+            if (domains[r].contains(b.x, b.y)) {
+                owner = r;
+                break;
+            }
+        }
+        local[3 * owner] += 1.0;
+        local[3 * owner + 2] += work_[i];
+        for (int r = 0; r < size_; r++) {
+            if (r != owner && domains[r].near(b.x, b.y, VISUAL_RANGE)) local[3 * r + 1] += 1.0;
+        }
+    }
+    MPI_Allreduce(local.data(), global.data(), 3 * size_, MPI_DOUBLE, MPI_SUM, comm_);
+
+    std::vector<double> work(size_);
+    double passes = 0.0;
+    for (int r = 0; r < size_; r++) {
+        double owned = global[3 * r], ghosts = global[3 * r + 1];
+        work[r] = owned * (owned + ghosts) + RCB_NEIGHBOR_COST * global[3 * r + 2];
+        passes += owned + ghosts;
+    }
+    if (mean_pass) *mean_pass = passes / size_;
+    return work;
+}
+
+// Recursive coordinate bisection, one level of the tree at a time so that
+// every level costs RCB_ITERATIONS allreduces whatever the number of ranks
+RebalanceReport DistributedWorld::rebalance() {
+    RebalanceReport report;
+    double pass = 0.0;
+    report.imbalance_before = imbalance_of(work_per_rank(domains_, &pass));
+
+    struct Region {
+        Domain box;
+        int r0, r1; // ranks [r0, r1) share this region
+    };
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<Region> regions = {{{-inf, -inf, inf, inf}, 0, size_}};
+    std::vector<int> region_of(num_owned_);
+
+    while (true) {
+        int n = static_cast<int>(regions.size());
+        bool any_split = false;
+        for (const auto& reg : regions) any_split |= reg.r1 - reg.r0 > 1;
+        if (!any_split) break;
+
+        for (int i = 0; i < num_owned_; i++) {
+            region_of[i] = -1;
+            for (int k = 0; k < n; k++) {
+                if (regions[k].box.contains(boids_[i].x, boids_[i].y)) {
+                    region_of[i] = k;
+                    break;
+                }
+            }
+        }
+
+        // Global bounding box of each region's boids picks the axis to cut
+        std::vector<float> local_box(4 * n, inf), box(4 * n);
+        for (int i = 0; i < num_owned_; i++) {
+            int k = region_of[i];
+            if (k < 0) continue;
+            local_box[4 * k + 0] = std::min(local_box[4 * k + 0], boids_[i].x);
+            local_box[4 * k + 1] = std::min(local_box[4 * k + 1], boids_[i].y);
+            local_box[4 * k + 2] = std::min(local_box[4 * k + 2], -boids_[i].x);
+            local_box[4 * k + 3] = std::min(local_box[4 * k + 3], -boids_[i].y);
+        }
+        MPI_Allreduce(local_box.data(), box.data(), 4 * n, MPI_FLOAT, MPI_MIN, comm_);
+
+        std::vector<int> axis(n);
+        std::vector<double> lo(n), hi(n);
+        for (int k = 0; k < n; k++) {
+            float x0 = box[4 * k + 0], y0 = box[4 * k + 1], x1 = -box[4 * k + 2], y1 = -box[4 * k + 3];
+            if (x0 > x1) {
+                // No boids in here: cut the region's own extent within the world
+                x0 = std::max(regions[k].box.x0, 0.0f);
+                x1 = std::min(regions[k].box.x1, static_cast<float>(WIDTH));
+                y0 = std::max(regions[k].box.y0, 0.0f);
+                y1 = std::min(regions[k].box.y1, static_cast<float>(HEIGHT));
+            }
+            axis[k] = (x1 - x0 >= y1 - y0) ? 0 : 1;
+            lo[k] = axis[k] == 0 ? x0 : y0;
+            hi[k] = axis[k] == 0 ? x1 : y1;
+        }
+
+        // Bisect on the cut coordinate until the weight below it matches the
+        // share of ranks that goes to the lower half
+        std::vector<double> below(2 * n), global(2 * n);
+        for (int iter = 0; iter < RCB_ITERATIONS; iter++) {
+            std::fill(below.begin(), below.end(), 0.0);
+            for (int i = 0; i < num_owned_; i++) {
+                int k = region_of[i];
+                if (k < 0) continue;
+                double c = axis[k] == 0 ? boids_[i].x : boids_[i].y;
+                double weight = pass + RCB_NEIGHBOR_COST * work_[i];
+                below[2 * k + 1] += weight;
+                if (c < 0.5 * (lo[k] + hi[k])) below[2 * k] += weight;
+            }
+            MPI_Allreduce(below.data(), global.data(), 2 * n, MPI_DOUBLE, MPI_SUM, comm_);
+            for (int k = 0; k < n; k++) {
+                int ranks = regions[k].r1 - regions[k].r0;
+                double target = global[2 * k + 1] * (ranks / 2) / ranks;
+                double mid = 0.5 * (lo[k] + hi[k]);
+                if (global[2 * k] < target) lo[k] = mid;
+                else hi[k] = mid;
+            }
+        }
+
+        std::vector<Region> next;
+        for (int k = 0; k < n; k++) {
+            const Region& reg = regions[k];
+            if (reg.r1 - reg.r0 == 1) {
+                next.push_back(reg);
+                continue;
+            }
+            float cut = static_cast<float>(0.5 * (lo[k] + hi[k]));
+            int middle = reg.r0 + (reg.r1 - reg.r0) / 2;
+            Region low = reg, high = reg;
+            if (axis[k] == 0) {
+                low.box.x1 = cut;
+                high.box.x0 = cut;
+            } else {
+                low.box.y1 = cut;
+                high.box.y0 = cut;
+            }
+            low.r1 = middle;
+            high.r0 = middle;
+            next.push_back(low);
+            next.push_back(high);
+        }
+        regions = next;
+    }
+
+    std::vector<Domain> balanced(size_);
+    for (const auto& reg : regions) balanced[reg.r0] = reg.box;
+    report.imbalance_after = imbalance_of(work_per_rank(balanced));
+
+    // The cuts cannot see how many ghosts they create; keep the old domains
+    // when the new ones would load the heaviest rank more
+    if (report.imbalance_after >= report.imbalance_before) {
+        report.imbalance_after = report.imbalance_before;
+        return report;
+    }
+    domains_ = balanced;
+    migrate();
+    return report;
+}
+
+long DistributedWorld::total_boids() const {
+    long local = num_owned_, total = 0;
+    MPI_Allreduce(&local, &total, 1, MPI_LONG, MPI_SUM, comm_);
+    return total;
+}
@@ -0,0 +1,115 @@
+//
+// Domain-decomposed simulation over MPI ranks, each rank stepping its own
+// boids on a local worker pool.
+//
+
+#ifndef DISTRIBUTED_WORLD_H
+#define DISTRIBUTED_WORLD_H
+
+#include <mpi.h>
+
+#include <atomic>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Interior boids handed out per grab of the dynamic schedule
+#define INTERIOR_CHUNK 64
+// Bisection steps used to place each cut of the coordinate bisection
+#define RCB_ITERATIONS 24
+// Extra work of a neighbour in range over the distance test every other
+// boid gets, in units of that test
+#define RCB_NEIGHBOR_COST 1.0
+
+// Rectangle of the world owned by one rank; edge domains extend to infinity
+struct Domain {
+    float x0, y0, x1, y1;
+
+    bool contains(float x, float y) const { return x >= x0 && x < x1 && y >= y0 && y < y1; }
+    // True if (x, y) lies within range of the rectangle, so its owner may see it
+    bool near(float x, float y, float range) const {
+        return x >= x0 - range && x < x1 + range && y >= y0 - range && y < y1 + range;
+    }
+};
+
+// Per-rank timings accumulated over the steps, in seconds
+struct HaloStats {
+    int steps = 0;
+    long ghosts_received = 0;
+    double step_seconds = 0.0;
+    double interior_seconds = 0.0;
+    double border_seconds = 0.0;
+    double comm_seconds = 0.0;     // from posting the exchange until it completed
+    double exposed_seconds = 0.0;  // part of it the rank sat waiting after the interior work
+};
+
+// Work of the heaviest rank over the average rank around one rebalance
+struct RebalanceReport {
+    double imbalance_before = 1.0;
+    double imbalance_after = 1.0;
+};
+
+class DistributedWorld {
+public:
+    // Splits the world in a grid of tiles, one per rank, and keeps the boids
+    // of this rank's tile out of a population generated identically everywhere
+    DistributedWorld(MPI_Comm comm, int total_boids, unsigned int seed);
+
+    // One step: the halo exchange is in flight while interior boids are
+    // updated, border boids are finished once the ghosts arrived
+    void step(WorkerPool& pool, float deltaTime);
+
+    // Hands boids that left this rank's domain to their new owners in one exchange
+    void migrate();
+
+    // Redraws the domains by recursive coordinate bisection so that every rank
+    // gets the same brute-force work, then migrates the boids in one exchange.
+    // A rank's work is a pass over its owned and ghost boids for every owned
+    // boid plus the neighbours they accumulate; at balance every pass is the
+    // same length, so the cuts weigh each boid by that mean pass. The new
+    // domains are only taken if they lower the predicted imbalance.
+    RebalanceReport rebalance();
+
+    int rank() const { return rank_; }
+    int size() const { return size_; }
+    const std::vector<Domain>& domains() const { return domains_; }
+    const BoidVector& boids() const { return boids_; }
+    const HaloStats& stats() const { return stats_; }
+    long total_boids() const;
+
+private:
+    // Boid carried across ranks together with its last measured work
+    struct Migrant {
+        Boid boid;
+        int work;
+    };
+
+    std::vector<double> work_per_rank(const std::vector<Domain>& domains, double* mean_pass = nullptr) const;
+    int owner_of(float x, float y) const;
+    void classify();
+    void post_halo();
+    void progress_halo();
+    void finish_halo();
+
+    MPI_Comm comm_;
+    int rank_ = 0, size_ = 1;
+    std::vector<Domain> domains_;
+
+    // Owned boids first, ghosts appended behind them while border boids update
+    BoidVector boids_;
+    int num_owned_ = 0;
+    std::vector<int> interior_, border_;
+    std::vector<int> work_; // neighbour count of each owned boid in the last step
+
+    std::vector<BoidVector> send_, recv_;
+    std::vector<int> send_counts_, recv_counts_;
+    std::vector<MPI_Request> data_requests_;
+    MPI_Request count_request_ = MPI_REQUEST_NULL;
+    bool receives_posted_ = false, halo_done_ = false;
+    double halo_posted_at_ = 0.0, halo_done_at_ = 0.0;
+
+    std::atomic<int> next_chunk_{0};
+    HaloStats stats_;
+};
+
+#endif //DISTRIBUTED_WORLD_H
@@ -0,0 +1,169 @@
+#include "fft_convolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+static int next_power_of_two(int n) {
+    int p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static inline std::complex<float> multiply(std::complex<float> a, std::complex<float> b) {
+    // Plain formula, without the inf/nan recovery of operator*
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+FFTPlan::FFTPlan(int n) : n_(n), bit_reverse_(n), twiddles_(n / 2) {
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        bit_reverse_[i] = r;
+    }
+    for (int k = 0; k < n / 2; k++) {
+        double angle = -2.0 * 3.14159265358979323846 * k / n;
+        twiddles_[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+}
+
+void FFTPlan::transform(std::complex<float>* data, bool inverse) const {
+    for (int i = 0; i < n_; i++) {
+        if (i < bit_reverse_[i]) std::swap(data[i], data[bit_reverse_[i]]);
+    }
+    for (int len = 2; len <= n_; len <<= 1) {
+        int half = len / 2;
+        int step = n_ / len;
+        for (int i = 0; i < n_; i += len) {
+            for (int j = 0; j < half; j++) {
+                std::complex<float> w = twiddles_[j * step];
+                if (inverse) w = std::conj(w);
+                std::complex<float> u = data[i + j];
+                std::complex<float> v = multiply(data[i + j + half], w);
+                data[i + j] = u + v;
+                data[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+void DiscConvolver::prepare(WorkerPool& pool, int cols, int rows, float radius) {
+    if (cols == cols_ && rows == rows_ && radius == radius_) return;
+    cols_ = cols;
+    rows_ = rows;
+    radius_ = radius;
+
+    // Padding of at least the radius keeps the circular convolution from
+    // wrapping boids on one edge onto the other
+    int reach = static_cast<int>(radius);
+    int padded_cols = next_power_of_two(cols + reach + 1);
+    int padded_rows = next_power_of_two(rows + reach + 1);
+    if (row_plan_.size() != padded_cols) row_plan_ = FFTPlan(padded_cols);
+    if (col_plan_.size() != padded_rows) col_plan_ = FFTPlan(padded_rows);
+    column_buffers_.assign(pool.size(), std::vector<std::complex<float>>(padded_rows));
+
+    // Disc centred on node (0, 0), negative offsets wrapped to the far end
+    spectrum_.assign(static_cast<size_t>(padded_cols) * padded_rows, 0.0f);
+    float scale = 1.0f / (static_cast<float>(padded_cols) * padded_rows);
+    for (int dy = -reach; dy <= reach; dy++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+            if (dx*dx + dy*dy > radius*radius) continue;
+            int x = (dx + padded_cols) % padded_cols;
+            int y = (dy + padded_rows) % padded_rows;
+            spectrum_[static_cast<size_t>(y) * padded_cols + x] = scale;
+        }
+    }
+    forward(pool, spectrum_, padded_rows);
+}
+
+void DiscConvolver::column_pass(WorkerPool& pool, std::vector<std::complex<float>>& grid, bool inverse) {
+    int padded_cols = row_plan_.size();
+    int padded_rows = col_plan_.size();
+    unsigned int num_threads = pool.size();
+    pool.run([&](unsigned int t) {
+        std::vector<std::complex<float>>& column = column_buffers_[t];
+        int begin = padded_cols * t / num_threads;
+        int end = padded_cols * (t + 1) / num_threads;
+        for (int x = begin; x < end; x++) {
+            for (int y = 0; y < padded_rows; y++) column[y] = grid[static_cast<size_t>(y) * padded_cols + x];
+            col_plan_.transform(column.data(), inverse);
+            for (int y = 0; y < padded_rows; y++) grid[static_cast<size_t>(y) * padded_cols + x] = column[y];
+        }
+    });
+}
+
+void DiscConvolver::forward(WorkerPool& pool, std::vector<std::complex<float>>& grid, int data_rows) {
+    int padded_cols = row_plan_.size();
+    unsigned int num_threads = pool.size();
+    // Rows past data_rows are all zero and stay zero
+    pool.run([&](unsigned int t) {
+        int begin = data_rows * t / num_threads;
+        int end = data_rows * (t + 1) / num_threads;
+        for (int y = begin; y < end; y++) row_plan_.transform(&grid[static_cast<size_t>(y) * padded_cols], false);
+    });
+    column_pass(pool, grid, false);
+}
+
+void DiscConvolver::inverse(WorkerPool& pool, std::vector<std::complex<float>>& grid, int data_rows) {
+    int padded_cols = row_plan_.size();
+    unsigned int num_threads = pool.size();
+    column_pass(pool, grid, true);
+    // Only the rows that map back onto the grid are needed
+    pool.run([&](unsigned int t) {
+        int begin = data_rows * t / num_threads;
+        int end = data_rows * (t + 1) / num_threads;
+        for (int y = begin; y < end; y++) row_plan_.transform(&grid[static_cast<size_t>(y) * padded_cols], true);
+    });
+}
+
+void DiscConvolver::convolve(WorkerPool& pool, const float* in, float* out, int fields) {
+    int padded_cols = row_plan_.size();
+    unsigned int num_threads = pool.size();
+    work_.resize(spectrum_.size());
+
+    for (int f = 0; f < fields; f += 2) {
+        bool pair = f + 1 < fields;
+
+        std::fill(work_.begin(), work_.end(), std::complex<float>(0.0f, 0.0f));
+        pool.run([&](unsigned int t) {
+            int begin = rows_ * t / num_threads;
+            int end = rows_ * (t + 1) / num_threads;
+            for (int y = begin; y < end; y++) {
+                for (int x = 0; x < cols_; x++) {
+                    const float* node = in + (static_cast<size_t>(y) * cols_ + x) * fields;
+                    work_[static_cast<size_t>(y) * padded_cols + x] = {node[f], pair ? node[f + 1] : 0.0f};
+                }
+            }
+        });
+
+        forward(pool, work_, rows_);
+        pool.run([&](unsigned int t) {
+            size_t begin = work_.size() * t / num_threads;
+            size_t end = work_.size() * (t + 1) / num_threads;
+            for (size_t k = begin; k < end; k++) work_[k] = multiply(work_[k], spectrum_[k]);
+        });
+        inverse(pool, work_, rows_);
+
+        pool.run([&](unsigned int t) {
+            int begin = rows_ * t / num_threads;
+            int end = rows_ * (t + 1) / num_threads;
+            for (int y = begin; y < end; y++) {
+                for (int x = 0; x < cols_; x++) {
+                    float* node = out + (static_cast<size_t>(y) * cols_ + x) * fields;
+                    std::complex<float> v = work_[static_cast<size_t>(y) * padded_cols + x];
+                    node[f] = v.real();
+                    if (pair) node[f + 1] = v.imag();
+                }
+            }
+        });
+    }
+}
+
+void FFTParticleInCell::smooth(WorkerPool& pool, const BoidParams& params) {
+    smoothed_.resize(summed_.size());
+    convolver_.prepare(pool, cols_, rows_, params.visual_range / cell_size_);
+    convolver_.convolve(pool, summed_.data(), smoothed_.data(), PIC_FIELDS);
+}
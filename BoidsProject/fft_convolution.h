@@ -0,0 +1,73 @@
+//
+// Self-contained radix-2 FFT and the threaded 2D disc convolution built on
+// it, used to smooth particle-in-cell grids at a cost independent of range.
+//
+
+#ifndef FFT_CONVOLUTION_H
+#define FFT_CONVOLUTION_H
+
+#include <complex>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "particle_in_cell.h"
+
+// Iterative in-place complex FFT of one power-of-two length
+class FFTPlan {
+public:
+    explicit FFTPlan(int n = 1);
+
+    int size() const { return n_; }
+    // Unscaled in both directions: inverse(forward(x)) is n * x
+    void transform(std::complex<float>* data, bool inverse) const;
+
+private:
+    int n_;
+    std::vector<int> bit_reverse_;
+    std::vector<std::complex<float>> twiddles_; // exp(-2 pi i k / n) for k < n / 2
+};
+
+// Linear convolution of real node grids with a disc, through zero-padded
+// 2D FFTs. The disc is symmetric, so its spectrum is real and two real
+// grids can share one complex transform as its real and imaginary parts;
+// five fields take three transforms. Row and column passes are split
+// over the pool, and rows that are all padding are skipped.
+class DiscConvolver {
+public:
+    // Sizes the transforms for a cols x rows grid and a disc of radius
+    // cells; the kernel spectrum is only recomputed when these change
+    void prepare(WorkerPool& pool, int cols, int rows, float radius);
+
+    // out = in convolved with the disc, fields floats per node, row-major
+    void convolve(WorkerPool& pool, const float* in, float* out, int fields);
+
+    int padded_cols() const { return row_plan_.size(); }
+    int padded_rows() const { return col_plan_.size(); }
+
+private:
+    void forward(WorkerPool& pool, std::vector<std::complex<float>>& grid, int data_rows);
+    void inverse(WorkerPool& pool, std::vector<std::complex<float>>& grid, int data_rows);
+    void column_pass(WorkerPool& pool, std::vector<std::complex<float>>& grid, bool inverse);
+
+    int cols_ = 0, rows_ = 0;
+    float radius_ = -1.0f;
+    FFTPlan row_plan_, col_plan_;
+    std::vector<std::complex<float>> spectrum_; // disc spectrum, scaled by 1 / (padded cols * padded rows)
+    std::vector<std::complex<float>> work_;
+    std::vector<std::vector<std::complex<float>>> column_buffers_;
+};
+
+// ParticleInCell whose smoothing runs through DiscConvolver instead of the
+// direct sum over the disc
+class FFTParticleInCell : public ParticleInCell {
+public:
+    using ParticleInCell::ParticleInCell;
+
+protected:
+    void smooth(WorkerPool& pool, const BoidParams& params) override;
+
+private:
+    DiscConvolver convolver_;
+};
+
+#endif //FFT_CONVOLUTION_H
@@ -0,0 +1,68 @@
+// Sweeps the visual range with a fixed node spacing and compares the
+// direct disc smoothing of the particle-in-cell engine with the FFT one.
+// Usage: BoidsFieldBench [num_boids] [steps] [node_spacing] [threads]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "fft_convolution.h"
+#include "initial_state.h"
+#include "particle_in_cell.h"
+
+#define BENCH_DT (1.0f / 60.0f)
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int num_boids = argc > 1 ? atoi(argv[1]) : 20000;
+    int steps = argc > 2 ? atoi(argv[2]) : 20;
+    float spacing = argc > 3 ? static_cast<float>(atof(argv[3])) : 10.0f;
+    unsigned int threads = argc > 4 ? static_cast<unsigned int>(atoi(argv[4])) : NUM_THREADS;
+
+    WorkerPool pool(threads);
+    BoidVector initial;
+    generate_boids(pool, initial, InitialLayout::Flocks, num_boids, 42);
+    printf("boids %d, steps %d, node spacing %.1f, threads %u\n", num_boids, steps, spacing, pool.size());
+    printf("%8s %8s %12s %12s %12s\n", "range", "disc", "direct ms", "fft ms", "max rel err");
+
+    const float ranges[] = {40, 80, 160, 320, 640};
+    for (float range : ranges) {
+        BoidParams params;
+        params.visual_range = range;
+
+        ParticleInCell direct;
+        FFTParticleInCell fft;
+        direct.set_node_spacing(spacing);
+        fft.set_node_spacing(spacing);
+
+        // One step from the same state to compare the fields
+        BoidVector a = initial, b = initial;
+        if (!direct.step(pool, a, BENCH_DT, params) || !fft.step(pool, b, BENCH_DT, params)) {
+            printf("%8.0f    grid too coarse for this range\n", range);
+            continue;
+        }
+        const std::vector<float>& fa = direct.field();
+        const std::vector<float>& fb = fft.field();
+        double peak = 0.0, err = 0.0;
+        for (size_t k = 0; k < fa.size(); k += PIC_FIELDS) peak = std::max(peak, double(fa[k]));
+        for (size_t k = 0; k < fa.size(); k += PIC_FIELDS) err = std::max(err, std::abs(double(fa[k]) - fb[k]));
+        size_t disc = ParticleInCell::disc_offsets(range / direct.cell_size()).size();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++) direct.step(pool, a, BENCH_DT, params);
+        double direct_ms = seconds_since(start) * 1e3 / steps;
+
+        start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++) fft.step(pool, b, BENCH_DT, params);
+        double fft_ms = seconds_since(start) * 1e3 / steps;
+
+        printf("%8.0f %8zu %12.3f %12.3f %12.2e\n", range, disc, direct_ms, fft_ms, peak > 0 ? err / peak : 0.0);
+        fflush(stdout);
+    }
+    return 0;
+}
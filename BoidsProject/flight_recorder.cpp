@@ -0,0 +1,186 @@
+#include "flight_recorder.h"
+
+#include <csignal>
+#include <cstring>
+
+static std::atomic<int> signal_dumps{0};
+
+static void on_dump_signal(int) {
+    signal_dumps.fetch_add(1);
+}
+
+// Receives the encoder's output and keeps only the newest frames that fit in capacity bytes
+class FlightRecorder::RingSink : public TrajectorySink {
+public:
+    explicit RingSink(size_t capacity) : capacity_(capacity) {}
+
+    bool write(const void* data, size_t bytes) override {
+        auto* p = static_cast<const uint8_t*>(data);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!have_header_) {
+            if (bytes != sizeof(header_)) return false;
+            std::memcpy(&header_, p, sizeof(header_));
+            have_header_ = true;
+            return true;
+        }
+        // Anything that is not a frame is the index written on close
+        TrajectoryFrameHeader frame;
+        if (bytes < sizeof(frame)) return true;
+        std::memcpy(&frame, p, sizeof(frame));
+        if (frame.magic != TRAJECTORY_FRAME_MAGIC) return true;
+
+        frames_.push_back(std::make_shared<const std::vector<uint8_t>>(p, p + bytes));
+        bytes_ += bytes;
+        if (frame.keyframe) keyframes_++;
+        while (bytes_ > capacity_ && frames_.size() > 1) {
+            TrajectoryFrameHeader oldest;
+            std::memcpy(&oldest, frames_.front()->data(), sizeof(oldest));
+            // The last keyframe stays, or nothing after it would decode
+            if (oldest.keyframe && keyframes_ == 1) break;
+            if (oldest.keyframe) keyframes_--;
+            bytes_ -= frames_.front()->size();
+            frames_.pop_front();
+        }
+        return true;
+    }
+
+    bool close() override { return true; }
+
+    // Copy of the ring, starting at its oldest keyframe so that it decodes
+    bool snapshot(TrajectoryFileHeader& header, std::vector<std::shared_ptr<const std::vector<uint8_t>>>& frames) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames.clear();
+        header = header_;
+        for (const auto& f : frames_) {
+            TrajectoryFrameHeader h;
+            std::memcpy(&h, f->data(), sizeof(h));
+            if (frames.empty() && !h.keyframe) continue;
+            frames.push_back(f);
+        }
+        return have_header_ && !frames.empty();
+    }
+
+private:
+    size_t capacity_;
+    size_t bytes_ = 0;
+    size_t keyframes_ = 0;
+    std::mutex mutex_;
+    bool have_header_ = false;
+    TrajectoryFileHeader header_{};
+    std::deque<std::shared_ptr<const std::vector<uint8_t>>> frames_;
+};
+
+FlightRecorder::FlightRecorder(const std::string& dump_prefix, const BoidParams& params, size_t ring_bytes,
+                               double trigger_ms)
+    : prefix_(dump_prefix), trigger_seconds_(trigger_ms / 1e3), ring_(std::make_shared<RingSink>(ring_bytes)),
+      seen_signals_(signal_dumps.load()) {
+    // The encoder owns a sink that forwards to the shared ring
+    struct Forward : TrajectorySink {
+        std::shared_ptr<RingSink> ring;
+        bool write(const void* data, size_t bytes) override { return ring->write(data, bytes); }
+        bool close() override { return true; }
+    };
+    std::unique_ptr<Forward> forward(new Forward());
+    forward->ring = ring_;
+    encoder_.reset(new TrajectoryRecorder(std::move(forward), params, FLIGHT_KEYFRAME_INTERVAL, DEFAULT_QUANTUM, 1,
+                                          FLIGHT_KEYFRAME_INTERVAL));
+}
+
+FlightRecorder::~FlightRecorder() {
+    if (dumper_.joinable()) dumper_.join();
+    encoder_->close();
+}
+
+void FlightRecorder::install_signal_trigger() {
+    signal(SIGUSR1, on_dump_signal);
+}
+
+void FlightRecorder::request_dump(const char* reason) {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    requested_ = reason;
+}
+
+void FlightRecorder::record(const BoidVector& boids, uint64_t step, double step_seconds) {
+    encoder_->record(boids, step);
+
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        reason.swap(requested_);
+    }
+    int signals = signal_dumps.load();
+    if (reason.empty() && signals != seen_signals_) reason = "signal";
+    seen_signals_ = signals;
+
+    bool cooled_down = !triggered_once_ || step >= last_trigger_step_ + FLIGHT_COOLDOWN_STEPS;
+    if (reason.empty() && step_seconds > trigger_seconds_ && cooled_down) reason = "slowstep";
+    if (reason.empty()) return;
+
+    triggered_once_ = true;
+    last_trigger_step_ = step;
+    start_dump(step, reason);
+}
+
+// The dump runs on its own thread so the step loop only pays for record().
+// A trigger during a dump is kept and dumped right after it; further ones
+// before that starts would dump the same ring and are folded into it.
+void FlightRecorder::start_dump(uint64_t step, const std::string& reason) {
+    std::string path = prefix_ + "_" + std::to_string(step) + "_" + reason + ".btrj";
+    {
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        if (dumping_) {
+            if (pending_path_.empty()) pending_path_ = path;
+            return;
+        }
+        dumping_ = true;
+    }
+    if (dumper_.joinable()) dumper_.join();
+    dumper_ = std::thread([this, path] {
+        std::string next = path;
+        while (!next.empty()) {
+            // Let the frames still being compressed, including this step's, reach the ring
+            encoder_->flush();
+            write_dump(next);
+            std::lock_guard<std::mutex> lock(request_mutex_);
+            next.swap(pending_path_);
+            pending_path_.clear();
+            if (next.empty()) dumping_ = false;
+        }
+    });
+}
+
+void FlightRecorder::write_dump(const std::string& path) {
+    TrajectoryFileHeader header;
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> frames;
+    if (!ring_->snapshot(header, frames)) return;
+
+    auto sink = open_file_sink(path);
+    if (!sink) return;
+    bool ok = sink->write(&header, sizeof(header));
+    uint64_t offset = sizeof(header);
+    std::vector<TrajectoryKeyframe> keyframes;
+    for (size_t i = 0; i < frames.size(); i++) {
+        TrajectoryFrameHeader h;
+        std::memcpy(&h, frames[i]->data(), sizeof(h));
+        if (h.keyframe) keyframes.push_back({i, offset});
+        ok = ok && sink->write(frames[i]->data(), frames[i]->size());
+        offset += frames[i]->size();
+    }
+    TrajectoryTrailer trailer;
+    trailer.index_offset = offset;
+    trailer.frames = frames.size();
+    trailer.keyframes = static_cast<uint32_t>(keyframes.size());
+    trailer.magic = TRAJECTORY_INDEX_MAGIC;
+    ok = ok && sink->write(keyframes.data(), keyframes.size() * sizeof(TrajectoryKeyframe));
+    ok = ok && sink->write(&trailer, sizeof(trailer)) && sink->close();
+    if (!ok) return;
+
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    last_dump_ = path;
+    dumps_++;
+}
+
+std::string FlightRecorder::last_dump() const {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    return last_dump_;
+}
@@ -0,0 +1,78 @@
+//
+// Always-on flight recorder: keeps the last frames of the run compressed in
+// memory and dumps them as a replayable trajectory when something goes wrong.
+//
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trajectory.h"
+
+// Compressed frames kept in memory: ten seconds at 60 steps per second of
+// about 75k boids, a second of 1M. The ring only goes over it to keep one
+// keyframe, so that a dump always decodes.
+#define FLIGHT_RING_BYTES (64u << 20)
+#define FLIGHT_KEYFRAME_INTERVAL 30
+#define FLIGHT_TRIGGER_MS 50.0      // step time that counts as an anomaly
+#define FLIGHT_COOLDOWN_STEPS 600   // steps between two threshold dumps
+
+class FlightRecorder {
+public:
+    // Dumps go to <prefix>_<step>_<reason>.btrj
+    FlightRecorder(const std::string& dump_prefix, const BoidParams& params,
+                   size_t ring_bytes = FLIGHT_RING_BYTES, double trigger_ms = FLIGHT_TRIGGER_MS);
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // Call once per step with the new state and the time the step took;
+    // fires the threshold and signal triggers
+    void record(const BoidVector& boids, uint64_t step, double step_seconds);
+
+    // Asks for a dump at the next record(), e.g. from a keypress
+    void request_dump(const char* reason);
+
+    // Makes SIGUSR1 request a dump from every FlightRecorder
+    static void install_signal_trigger();
+
+    // Path of the last finished dump, empty if none yet
+    std::string last_dump() const;
+    int dumps() const { return dumps_.load(); }
+
+private:
+    class RingSink;
+
+    void start_dump(uint64_t step, const std::string& reason);
+    void write_dump(const std::string& path);
+
+    std::string prefix_;
+    double trigger_seconds_;
+    std::shared_ptr<RingSink> ring_;
+    int seen_signals_;
+    std::unique_ptr<TrajectoryRecorder> encoder_;
+
+    std::mutex request_mutex_;
+    std::string requested_;
+    // A trigger that came while a dump was running, started when it ends
+    bool dumping_ = false;
+    std::string pending_path_;
+    uint64_t last_trigger_step_ = 0;
+    bool triggered_once_ = false;
+
+    std::thread dumper_;
+    std::atomic<int> dumps_{0};
+    mutable std::mutex dump_mutex_;
+    std::string last_dump_;
+};
+
+#endif //FLIGHT_RECORDER_H
@@ -0,0 +1,302 @@
+#include "flow_field.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "initial_state.h"
+
+const char* flow_pattern_name(FlowPattern pattern) {
+    switch (pattern) {
+        case FlowPattern::Vortices: return "vortices";
+        case FlowPattern::Shear: return "shear";
+        case FlowPattern::Gusts: return "gusts";
+    }
+    return "unknown";
+}
+
+bool parse_flow_pattern(const char* name, FlowPattern* pattern) {
+    for (FlowPattern p : {FlowPattern::Vortices, FlowPattern::Shear, FlowPattern::Gusts}) {
+        if (strcmp(name, flow_pattern_name(p)) == 0) {
+            *pattern = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+class ProceduralFlow : public FlowSource {
+public:
+    ProceduralFlow(FlowPattern pattern, float width, float height, uint64_t seed, float speed)
+        : pattern_(pattern), speed_(speed) {
+        layout_.cols = std::max(2, static_cast<int>(std::ceil(width / FLOW_NODE_SPACING)) + 1);
+        layout_.rows = std::max(2, static_cast<int>(std::ceil(height / FLOW_NODE_SPACING)) + 1);
+        layout_.width = width;
+        layout_.height = height;
+        layout_.frame_seconds = FLOW_FRAME_SECONDS;
+        layout_.frames = 0;
+
+        for (int k = 0; k < FLOW_VORTICES; k++) {
+            IndexRandom rng(seed, k);
+            Vortex v;
+            v.x = rng.uniform(0.2f, 0.8f) * width;
+            v.y = rng.uniform(0.2f, 0.8f) * height;
+            v.orbit = rng.uniform(0.05f, 0.2f) * std::min(width, height);
+            v.omega = rng.uniform(0.05f, 0.2f);
+            v.phase = rng.uniform(0.0f, TWO_PI);
+            v.sign = k % 2 ? -1.0f : 1.0f;
+            vortices_.push_back(v);
+        }
+        IndexRandom rng(seed, FLOW_VORTICES);
+        heading_ = rng.uniform(0.0f, TWO_PI);
+    }
+
+    const FlowLayout& layout() const override { return layout_; }
+
+    bool frame(uint64_t index, float* u, float* v) override {
+        float t = index * layout_.frame_seconds;
+        float dx = layout_.width / (layout_.cols - 1);
+        float dy = layout_.height / (layout_.rows - 1);
+        for (int r = 0; r < layout_.rows; r++) {
+            for (int c = 0; c < layout_.cols; c++) {
+                int k = r * layout_.cols + c;
+                wind(c * dx, r * dy, t, &u[k], &v[k]);
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Vortex {
+        float x, y, orbit, omega, phase, sign;
+    };
+
+    void wind(float x, float y, float t, float* u, float* v) const {
+        float w = layout_.width, h = layout_.height;
+        switch (pattern_) {
+            case FlowPattern::Vortices: {
+                // Rankine-like eddies: solid rotation inside the core, peaking at speed
+                float core = std::min(w, h) / 8;
+                *u = *v = 0.0f;
+                for (const auto& e : vortices_) {
+                    float cx = e.x + e.orbit * std::cos(e.omega * t + e.phase);
+                    float cy = e.y + e.orbit * std::sin(e.omega * t + e.phase);
+                    float rx = x - cx, ry = y - cy;
+                    float s = e.sign * 2 * core * speed_ / (rx*rx + ry*ry + core*core);
+                    *u -= s * ry;
+                    *v += s * rx;
+                }
+                break;
+            }
+            case FlowPattern::Shear:
+                *u = speed_ * std::sin(2 * TWO_PI * y / h + 0.3f * t);
+                *v = 0.3f * speed_ * std::sin(TWO_PI * x / w - 0.2f * t);
+                break;
+            case FlowPattern::Gusts: {
+                float heading = heading_ + 0.1f * t;
+                float pulse = 0.6f + 0.4f * std::sin(1.3f * t);
+                // Travelling along the wind, so gusts sweep through the flock
+                float along = (x * std::cos(heading) + y * std::sin(heading)) / std::max(w, h);
+                float wave = 1.0f + 0.5f * std::sin(3 * TWO_PI * along - 2.0f * t);
+                *u = speed_ * pulse * wave * std::cos(heading);
+                *v = speed_ * pulse * wave * std::sin(heading);
+                break;
+            }
+        }
+    }
+
+    FlowLayout layout_;
+    FlowPattern pattern_;
+    float speed_;
+    float heading_;
+    std::vector<Vortex> vortices_;
+};
+
+std::unique_ptr<FlowSource> make_procedural_flow(FlowPattern pattern, float width, float height, uint64_t seed,
+                                                 float speed) {
+    return std::make_unique<ProceduralFlow>(pattern, width, height, seed, speed);
+}
+
+class FileFlow : public FlowSource {
+public:
+    ~FileFlow() override {
+        if (file_) fclose(file_);
+    }
+
+    bool open(const std::string& path) {
+        file_ = fopen(path.c_str(), "rb");
+        FlowFileHeader header;
+        if (!file_ || fread(&header, sizeof(header), 1, file_) != 1) return false;
+        if (header.magic != FLOW_MAGIC || header.version != FLOW_VERSION) return false;
+        if (header.cols < 2 || header.rows < 2 || header.frames == 0) return false;
+        if (!(header.width > 0) || !(header.height > 0) || header.frame_seconds < 0) return false;
+        layout_.cols = static_cast<int>(header.cols);
+        layout_.rows = static_cast<int>(header.rows);
+        layout_.width = header.width;
+        layout_.height = header.height;
+        layout_.frame_seconds = header.frame_seconds;
+        layout_.frames = header.frames;
+        return true;
+    }
+
+    const FlowLayout& layout() const override { return layout_; }
+
+    bool frame(uint64_t index, float* u, float* v) override {
+        size_t nodes = static_cast<size_t>(layout_.cols) * layout_.rows;
+        long offset = static_cast<long>(sizeof(FlowFileHeader) + (index % layout_.frames) * 2 * nodes * sizeof(float));
+        return fseek(file_, offset, SEEK_SET) == 0 && fread(u, sizeof(float), nodes, file_) == nodes &&
+               fread(v, sizeof(float), nodes, file_) == nodes;
+    }
+
+private:
+    FILE* file_ = nullptr;
+    FlowLayout layout_;
+};
+
+std::unique_ptr<FlowSource> open_flow_file(const std::string& path) {
+    auto source = std::make_unique<FileFlow>();
+    if (!source->open(path)) return nullptr;
+    return source;
+}
+
+bool save_flow(const std::string& path, FlowSource& source, uint64_t frames) {
+    const FlowLayout& layout = source.layout();
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    FlowFileHeader header{FLOW_MAGIC, FLOW_VERSION, static_cast<uint32_t>(layout.cols),
+                          static_cast<uint32_t>(layout.rows), static_cast<uint32_t>(frames),
+                          layout.frame_seconds, layout.width, layout.height};
+    size_t nodes = static_cast<size_t>(layout.cols) * layout.rows;
+    std::vector<float> u(nodes), v(nodes);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint64_t k = 0; ok && k < frames; k++) {
+        ok = source.frame(k, u.data(), v.data()) && fwrite(u.data(), sizeof(float), nodes, file) == nodes &&
+             fwrite(v.data(), sizeof(float), nodes, file) == nodes;
+    }
+    return fclose(file) == 0 && ok;
+}
+
+FlowField::FlowField(std::unique_ptr<FlowSource> source, float strength)
+    : source_(std::move(source)), layout_(source_->layout()), strength_(strength) {
+    inv_dx_ = (layout_.cols - 1) / layout_.width;
+    inv_dy_ = (layout_.rows - 1) / layout_.height;
+    max_gx_ = std::nextafter(static_cast<float>(layout_.cols - 1), 0.0f);
+    max_gy_ = std::nextafter(static_cast<float>(layout_.rows - 1), 0.0f);
+
+    size_t nodes = static_cast<size_t>(layout_.cols) * layout_.rows;
+    front_u_.assign(nodes, 0.0f);
+    front_v_.assign(nodes, 0.0f);
+    failed_ = !source_->frame(0, front_u_.data(), front_v_.data());
+
+    // A single frame never changes and needs no loader
+    if (!failed_ && layout_.frame_seconds > 0 && layout_.frames != 1) {
+        back_u_.resize(nodes);
+        back_v_.resize(nodes);
+        wanted_ = 1;
+        loader_ = std::thread(&FlowField::loader_loop, this);
+    }
+}
+
+FlowField::~FlowField() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (loader_.joinable()) loader_.join();
+}
+
+void FlowField::loader_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&] { return stopping_ || !back_ready_; });
+        if (stopping_) return;
+        uint64_t index = wanted_;
+        lock.unlock();
+        bool ok = source_->frame(index, back_u_.data(), back_v_.data());
+        lock.lock();
+        back_index_ = index;
+        back_ok_ = ok;
+        back_ready_ = true;
+        cv_.notify_all();
+    }
+}
+
+void FlowField::advance(float deltaTime) {
+    time_ += deltaTime;
+    if (!loader_.joinable() || failed_) return;
+
+    uint64_t due = static_cast<uint64_t>(time_ / layout_.frame_seconds);
+    while (front_index_ < due) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!back_ready_) {
+            auto start = std::chrono::steady_clock::now();
+            cv_.wait(lock, [&] { return back_ready_; });
+            wait_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (!back_ok_) {
+            // back_ready_ stays set, which parks the loader for good
+            failed_ = true;
+            return;
+        }
+        front_u_.swap(back_u_);
+        front_v_.swap(back_v_);
+        front_index_ = back_index_;
+        wanted_ = front_index_ + 1;
+        back_ready_ = false;
+        cv_.notify_all();
+    }
+}
+
+void FlowField::sample(float x, float y, float* u, float* v) const {
+    sample_block(&x, &y, u, v, 1);
+}
+
+void FlowField::sample_block(const float* __restrict x, const float* __restrict y, float* __restrict u,
+                             float* __restrict v, int n) const {
+    const float* __restrict fu = front_u_.data();
+    const float* __restrict fv = front_v_.data();
+    const int cols = layout_.cols;
+    const float inv_dx = inv_dx_, inv_dy = inv_dy_, max_gx = max_gx_, max_gy = max_gy_;
+    // Clamped rather than tested, so the body is straight-line code and
+    // the node reads become gathers
+    for (int i = 0; i < n; i++) {
+        float gx = std::min(std::max(x[i] * inv_dx, 0.0f), max_gx);
+        float gy = std::min(std::max(y[i] * inv_dy, 0.0f), max_gy);
+        int ix = static_cast<int>(gx);
+        int iy = static_cast<int>(gy);
+        float fx = gx - ix, fy = gy - iy;
+        int k = iy * cols + ix;
+        float u0 = fu[k] + fx * (fu[k + 1] - fu[k]);
+        float u1 = fu[k + cols] + fx * (fu[k + cols + 1] - fu[k + cols]);
+        float v0 = fv[k] + fx * (fv[k + 1] - fv[k]);
+        float v1 = fv[k + cols] + fx * (fv[k + cols + 1] - fv[k + cols]);
+        u[i] = u0 + fy * (u1 - u0);
+        v[i] = v0 + fy * (v1 - v0);
+    }
+}
+
+void FlowField::apply(WorkerPool& pool, BoidVector& boids, float deltaTime) const {
+    const float scale = strength_ * deltaTime;
+    if (scale == 0.0f) return;
+    unsigned int num_threads = pool.size();
+    pool.run([&](unsigned int t) {
+        size_t begin = boids.size() * t / num_threads;
+        size_t end = boids.size() * (t + 1) / num_threads;
+        float x[FLOW_BLOCK], y[FLOW_BLOCK], u[FLOW_BLOCK], v[FLOW_BLOCK];
+        for (size_t first = begin; first < end; first += FLOW_BLOCK) {
+            int n = static_cast<int>(std::min<size_t>(FLOW_BLOCK, end - first));
+            for (int i = 0; i < n; i++) {
+                x[i] = boids[first + i].x;
+                y[i] = boids[first + i].y;
+            }
+            sample_block(x, y, u, v, n);
+            for (int i = 0; i < n; i++) {
+                boids[first + i].vx += scale * u[i];
+                boids[first + i].vy += scale * v[i];
+            }
+        }
+    });
+}
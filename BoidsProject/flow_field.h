@@ -0,0 +1,145 @@
+//
+// Environmental flow fields: a grid of wind vectors the boids are pushed
+// along, read from a file or generated procedurally, with the frames of a
+// time-varying field streamed in on a background thread.
+//
+
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boids_parallel.h"
+
+#define FLOW_MAGIC 0x574f4c46u // "FLOW"
+#define FLOW_VERSION 1
+
+// Velocity change per second for each unit of wind
+#define FLOW_STRENGTH 1.0f
+// Wind speed and node spacing of the procedural fields, in world units
+#define FLOW_SPEED 20.0f
+#define FLOW_NODE_SPACING 40.0f
+// Seconds between two frames of the procedural fields
+#define FLOW_FRAME_SECONDS 0.25f
+#define FLOW_VORTICES 6
+// Boids whose positions apply() copies out and samples in one vectorised pass
+#define FLOW_BLOCK 256
+
+// Header followed by frames, each frame cols * rows floats of u then as
+// many of v, row-major with nodes evenly spaced over [0, width] x [0, height]
+struct FlowFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t frames;
+    float frame_seconds; // 0 for a field that never changes
+    float width;
+    float height;
+};
+
+struct FlowLayout {
+    int cols = 2, rows = 2; // at least 2 each
+    float width = WIDTH, height = HEIGHT;
+    float frame_seconds = 0.0f;
+    uint64_t frames = 1; // 0 for an endless source
+};
+
+// Produces the frames of a field. frame() is only ever called from one
+// thread at a time, but not always the same one.
+class FlowSource {
+public:
+    virtual ~FlowSource() = default;
+    virtual const FlowLayout& layout() const = 0;
+    // Fills u and v, cols * rows each, with frame index; sources with a
+    // finite number of frames loop
+    virtual bool frame(uint64_t index, float* u, float* v) = 0;
+};
+
+enum class FlowPattern {
+    Vortices, // a few eddies drifting around the world
+    Shear,    // bands of opposite wind, sliding sideways over time
+    Gusts     // a prevailing wind that turns and pulses in travelling waves
+};
+
+const char* flow_pattern_name(FlowPattern pattern);
+// Accepts the names returned by flow_pattern_name()
+bool parse_flow_pattern(const char* name, FlowPattern* pattern);
+
+// Endless procedural field over a width x height world; every frame is a
+// pure function of (seed, index)
+std::unique_ptr<FlowSource> make_procedural_flow(FlowPattern pattern, float width, float height, uint64_t seed,
+                                                 float speed = FLOW_SPEED);
+// Frames of a flow file, nullptr if it is missing or malformed
+std::unique_ptr<FlowSource> open_flow_file(const std::string& path);
+// Writes the first frames frames of source as a flow file
+bool save_flow(const std::string& path, FlowSource& source, uint64_t frames);
+
+// Samples the current frame of a source into the boid velocities, in
+// blocks whose positions are copied out into plain arrays so the
+// interpolation vectorises. Frame k + 1 is loaded into a back buffer while
+// frame k is in use, and the two are swapped once the simulated time
+// reaches it; the simulation only waits if the loader fell behind.
+class FlowField {
+public:
+    explicit FlowField(std::unique_ptr<FlowSource> source, float strength = FLOW_STRENGTH);
+    ~FlowField();
+
+    FlowField(const FlowField&) = delete;
+    FlowField& operator=(const FlowField&) = delete;
+
+    // False once the source failed to deliver a frame; the last good frame stays in use
+    bool ok() const { return !failed_; }
+
+    // Moves the clock on and swaps in any frame that became due
+    void advance(float deltaTime);
+    // vx, vy += strength * wind(x, y) * deltaTime, wind interpolated bilinearly
+    void apply(WorkerPool& pool, BoidVector& boids, float deltaTime) const;
+    void sample(float x, float y, float* u, float* v) const;
+
+    float strength() const { return strength_; }
+    void set_strength(float strength) { strength_ = strength; }
+    const FlowLayout& layout() const { return layout_; }
+    uint64_t frame() const { return front_index_; }
+    // Time advance() spent waiting for the loader
+    double wait_seconds() const { return wait_seconds_; }
+
+private:
+    void loader_loop();
+    // Wind at n points of the current frame
+    void sample_block(const float* __restrict x, const float* __restrict y, float* __restrict u,
+                      float* __restrict v, int n) const;
+
+    std::unique_ptr<FlowSource> source_;
+    FlowLayout layout_;
+    float strength_;
+    float inv_dx_, inv_dy_;
+    float max_gx_, max_gy_; // keep the lower-left node one short of the last column and row
+    double time_ = 0.0;
+    double wait_seconds_ = 0.0;
+    bool failed_ = false;
+
+    // Sampled by apply(), only touched by the simulation thread
+    std::vector<float> front_u_, front_v_;
+    uint64_t front_index_ = 0;
+
+    // Owned by the loader while back_ready_ is false
+    std::vector<float> back_u_, back_v_;
+    uint64_t back_index_ = 0;
+    bool back_ok_ = true;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    uint64_t wanted_ = 0;
+    bool back_ready_ = false;
+    bool stopping_ = false;
+    std::thread loader_;
+};
+
+#endif //FLOW_FIELD_H
@@ -0,0 +1,80 @@
+#include "hilbert_partition.h"
+
+#include <algorithm>
+
+uint32_t hilbert_index(uint32_t x, uint32_t y) {
+    const uint32_t n = 1u << HILBERT_BITS;
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the sub-curve has the right orientation
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void HilbertPartitioner::partition(const BoidVector& boids, unsigned int num_parts, const BoidParams& params) {
+    int n = static_cast<int>(boids.size());
+    if (neighbor_counts_.size() != boids.size()) {
+        // No history for this population yet, assume uniform work
+        neighbor_counts_.assign(n, 0);
+    }
+
+    // Same scale on both axes keeps the curve cells square
+    const float extent = std::max(params.width, params.height);
+    const float scale = ((1u << HILBERT_BITS) - 1) / extent;
+
+    keys_.resize(n);
+    for (int i = 0; i < n; i++) {
+        uint32_t qx = static_cast<uint32_t>(clamp(boids[i].x, 0.0f, extent) * scale);
+        uint32_t qy = static_cast<uint32_t>(clamp(boids[i].y, 0.0f, extent) * scale);
+        keys_[i] = {hilbert_index(qx, qy), i};
+    }
+    std::sort(keys_.begin(), keys_.end());
+
+    // A boid costs one pass over the others plus its neighbour accumulation
+    const double pass = n > 0 ? n - 1 : 0;
+    auto cost = [&](int i) { return pass + HILBERT_NEIGHBOR_COST * neighbor_counts_[i]; };
+    double total = 0.0;
+    order_.resize(n);
+    for (int i = 0; i < n; i++) {
+        order_[i] = keys_[i].second;
+        total += cost(order_[i]);
+    }
+
+    bounds_.assign(num_parts + 1, n);
+    bounds_[0] = 0;
+    double prefix = 0.0, heaviest = 0.0, part_start = 0.0;
+    int pos = 0;
+    for (unsigned int t = 0; t < num_parts; t++) {
+        double target = total * (t + 1) / num_parts;
+        while (pos < n && (t == num_parts - 1 || prefix < target)) {
+            prefix += cost(order_[pos]);
+            pos++;
+        }
+        bounds_[t + 1] = pos;
+        heaviest = std::max(heaviest, prefix - part_start);
+        part_start = prefix;
+    }
+    predicted_imbalance_ = total > 0.0 ? heaviest / (total / num_parts) : 1.0;
+}
+
+void HilbertPartitioner::update(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params) {
+    partition(boids, pool.size(), params);
+
+    pool.run([&](unsigned int t) {
+        for (int k = bounds_[t]; k < bounds_[t + 1]; k++) {
+            int i = order_[k];
+            neighbor_counts_[i] = update_boid(boids, i, deltaTime, params);
+        }
+    });
+}
@@ -0,0 +1,52 @@
+//
+// Work-balanced spatial partitioning of the boids along a Hilbert curve.
+//
+
+#ifndef HILBERT_PARTITION_H
+#define HILBERT_PARTITION_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Bits per axis of the quantised positions fed to the curve
+#define HILBERT_BITS 16
+// Extra work of a neighbour in range over the distance test every other
+// boid gets, in units of that test
+#define HILBERT_NEIGHBOR_COST 1.0
+
+// Position of (x, y) along the Hilbert curve filling a 2^HILBERT_BITS square
+uint32_t hilbert_index(uint32_t x, uint32_t y);
+
+// Charges each boid the brute-force pass it costs: one distance test per
+// other boid plus the accumulation of last step's neighbours. Orders the
+// boids along the Hilbert curve and cuts the curve into one segment of
+// equal work per thread, so every thread gets a compact patch of the world
+// and roughly the same amount of neighbour processing.
+class HilbertPartitioner {
+public:
+    // Recomputes order() and bounds() for num_parts threads over the world of params
+    void partition(const BoidVector& boids, unsigned int num_parts, const BoidParams& params = DEFAULT_PARAMS);
+
+    // Partitions for the pool, runs one step and records the new neighbour counts
+    void update(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params = DEFAULT_PARAMS);
+
+    // Boid indices sorted along the curve; part t owns order()[bounds()[t] .. bounds()[t + 1])
+    const std::vector<int>& order() const { return order_; }
+    const std::vector<int>& bounds() const { return bounds_; }
+    const std::vector<int>& neighbor_counts() const { return neighbor_counts_; }
+
+    // Estimated work of the heaviest part over the average part, 1 is perfect balance
+    double predicted_imbalance() const { return predicted_imbalance_; }
+
+private:
+    std::vector<int> neighbor_counts_;
+    std::vector<std::pair<uint32_t, int>> keys_;
+    std::vector<int> order_;
+    std::vector<int> bounds_;
+    double predicted_imbalance_ = 1.0;
+};
+
+#endif //HILBERT_PARTITION_H
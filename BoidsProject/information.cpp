@@ -0,0 +1,87 @@
+#include "information.h"
+
+#include <algorithm>
+#include <functional>
+
+void InformationSpread::start(const BoidVector& boids) {
+    queue_.clear();
+    frontier_.clear();
+    time_ = 0.0;
+    add_sources(boids, 0);
+}
+
+void InformationSpread::add_sources(const BoidVector& boids, size_t first) {
+    for (size_t i = first; i < boids.size(); i++) {
+        if (boids[i].scout_group != 0) frontier_.push_back(static_cast<int>(i));
+    }
+}
+
+void InformationSpread::push(const Event& event) {
+    queue_.push_back(event);
+    std::push_heap(queue_.begin(), queue_.end(), std::greater<Event>());
+}
+
+void InformationSpread::fire(BoidVector& boids, float deltaTime) {
+    time_ += deltaTime;
+
+    while (!queue_.empty() && queue_.front().time <= time_) {
+        std::pop_heap(queue_.begin(), queue_.end(), std::greater<Event>());
+        Event event = queue_.back();
+        queue_.pop_back();
+        Boid& b = boids[event.boid];
+        if (event.group == 0) {
+            if (b.scout_group != 0) {
+                b.scout_group = 0;
+                b.biasval = 0.0f;
+                changes_++;
+            }
+            continue;
+        }
+        // Whoever got here first decides the direction
+        if (b.scout_group != 0) continue;
+        b.scout_group = event.group;
+        b.biasval = 0.0f;
+        changes_++;
+        frontier_.push_back(event.boid);
+        if (params_.memory > 0.0f) push({event.time + params_.memory, event.boid, 0});
+    }
+}
+
+void InformationSpread::broadcast(const UniformGrid& index, float slack, const BoidVector& boids) {
+    // A boid can be told several times before its first event fires; the
+    // later events find it informed and do nothing
+    const float range_squared = params_.range * params_.range;
+    for (int f : frontier_) {
+        const Boid& source = boids[f];
+        if (source.scout_group == 0) continue;
+        index.for_each_in_box(source.x, source.y, params_.range + slack, 0, 1, [&](int j) {
+            const Boid& other = boids[j];
+            if (other.scout_group != 0) return;
+            float dx = other.x - source.x;
+            float dy = other.y - source.y;
+            if (dx*dx + dy*dy < range_squared) push({time_ + params_.delay, j, source.scout_group});
+        });
+    }
+    frontier_.clear();
+}
+
+void InformationSpread::remap(const std::vector<int>& new_index) {
+    auto gone = [&](int& boid) {
+        boid = new_index[boid];
+        return boid < 0;
+    };
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&](Event& e) { return gone(e.boid); }), queue_.end());
+    std::make_heap(queue_.begin(), queue_.end(), std::greater<Event>());
+    frontier_.erase(std::remove_if(frontier_.begin(), frontier_.end(), gone), frontier_.end());
+}
+
+void InformationSpread::moved(int from, int to) {
+    auto gone = [&](int& boid) {
+        if (boid == to) return true;
+        if (boid == from) boid = to;
+        return false;
+    };
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&](Event& e) { return gone(e.boid); }), queue_.end());
+    std::make_heap(queue_.begin(), queue_.end(), std::greater<Event>());
+    frontier_.erase(std::remove_if(frontier_.begin(), frontier_.end(), gone), frontier_.end());
+}
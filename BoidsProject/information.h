@@ -0,0 +1,82 @@
+//
+// Event-driven spread of the scouts' heading bias: informed boids pass
+// their direction on to the boids around them, one relay delay later.
+//
+
+#ifndef INFORMATION_H
+#define INFORMATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "neighbor_grid.h"
+
+// Distance over which an informed boid passes its bias on
+#define RELAY_RANGE 40.0f
+// Seconds between a boid being informed and its neighbours following
+#define RELAY_DELAY 0.5f
+// Seconds a relayed boid keeps its bias before forgetting it, 0 for never
+#define RELAY_MEMORY 0.0f
+
+struct RelayParams {
+    float range = RELAY_RANGE;
+    float delay = RELAY_DELAY;
+    float memory = RELAY_MEMORY;
+};
+
+// The state is scout_group itself: 0 for uninformed, 1 or 2 for the
+// direction the boid was told. A boid only acts when its state changes:
+// once informed it joins the frontier, which is broadcast once, and every
+// uninformed boid within range then gets an event delay seconds later.
+// Events wait in a queue ordered by time, so a step costs the events due
+// and one grid query per frontier boid, never a pass over all boids.
+// Boids informed at start() or appearing later with a group are sources
+// and never forget.
+class InformationSpread {
+public:
+    explicit InformationSpread(const RelayParams& params = RelayParams()) : params_(params) {}
+
+    // Makes every boid that already has a scout group a source
+    void start(const BoidVector& boids);
+    // Makes boids [first, boids.size()) that have a scout group sources
+    void add_sources(const BoidVector& boids, size_t first);
+
+    // Moves the clock on by deltaTime and applies the events now due
+    void fire(BoidVector& boids, float deltaTime);
+    // Boids whose state changed since the last broadcast
+    bool has_frontier() const { return !frontier_.empty(); }
+    // Tells the uninformed boids around the frontier and empties it. index
+    // must bin the boids, possibly slack away from where they are now.
+    void broadcast(const UniformGrid& index, float slack, const BoidVector& boids);
+
+    // Keeps pending events on their boids after the state was reordered:
+    // new_index[i] is where boid i went, -1 if it was removed
+    void remap(const std::vector<int>& new_index);
+    // Boid from moved into slot to, whose own boid was removed
+    void moved(int from, int to);
+
+    const RelayParams& params() const { return params_; }
+    void set_params(const RelayParams& params) { params_ = params; }
+    size_t pending() const { return queue_.size(); }
+    // State changes made so far, informing and forgetting
+    uint64_t changes() const { return changes_; }
+
+private:
+    struct Event {
+        double time;
+        int boid;
+        int group; // 0 to forget
+        bool operator>(const Event& other) const { return time > other.time; }
+    };
+
+    void push(const Event& event);
+
+    RelayParams params_;
+    double time_ = 0.0;
+    uint64_t changes_ = 0;
+    std::vector<Event> queue_; // min-heap on time
+    std::vector<int> frontier_;
+};
+
+#endif //INFORMATION_H
@@ -0,0 +1,207 @@
+#include "initial_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BOIDS_HAVE_MMAP
+#else
+#include <cstdio>
+#endif
+
+#include "checkpoint.h"
+
+namespace {
+
+// Streams for the per-cluster and per-flock draws, kept apart from the boid streams
+const uint64_t CLUSTER_STREAM = 0xc1a55e5ull;
+const uint64_t FLOCK_STREAM = 0xf10c5ull;
+
+struct Blob {
+    float x, y;
+    float heading;
+};
+
+std::vector<Blob> make_blobs(uint64_t seed, uint64_t stream, int count, const BoidParams& params) {
+    std::vector<Blob> blobs(count);
+    for (int k = 0; k < count; k++) {
+        IndexRandom rng(seed ^ stream, k);
+        blobs[k].x = rng.uniform(0.1f, 0.9f) * params.width;
+        blobs[k].y = rng.uniform(0.1f, 0.9f) * params.height;
+        blobs[k].heading = rng.uniform(0.0f, TWO_PI);
+    }
+    return blobs;
+}
+
+} // namespace
+
+const char* layout_name(InitialLayout layout) {
+    switch (layout) {
+        case InitialLayout::Uniform: return "uniform";
+        case InitialLayout::Clusters: return "clusters";
+        case InitialLayout::Lattice: return "lattice";
+        case InitialLayout::Ring: return "ring";
+        case InitialLayout::Flocks: return "flocks";
+    }
+    return "unknown";
+}
+
+bool parse_layout(const char* name, InitialLayout* layout) {
+    const InitialLayout all[] = {InitialLayout::Uniform, InitialLayout::Clusters, InitialLayout::Lattice,
+                                 InitialLayout::Ring, InitialLayout::Flocks};
+    for (InitialLayout candidate : all) {
+        if (strcmp(name, layout_name(candidate)) == 0) {
+            *layout = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void generate_boids(WorkerPool& pool, BoidVector& boids, InitialLayout layout, size_t count,
+                    uint64_t seed, const BoidParams& params) {
+    // Nothing is written here: the old state is dropped rather than copied
+    // into a bigger buffer, and the new boids are first touched by the fill
+    boids.clear();
+    boids.resize(count);
+
+    std::vector<Blob> clusters = make_blobs(seed, CLUSTER_STREAM, INITIAL_CLUSTERS, params);
+    std::vector<Blob> flocks = make_blobs(seed, FLOCK_STREAM, INITIAL_FLOCKS, params);
+
+    // Lattice shape close to the aspect ratio of the world
+    size_t cols = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(count * params.width / params.height))));
+    size_t rows = std::max<size_t>(1, (count + cols - 1) / cols);
+    float ring_radius = 0.35f * std::min(params.width, params.height);
+    float cruise = 0.5f * (params.min_speed + params.max_speed);
+
+    unsigned int num_threads = pool.size();
+    pool.run([&](unsigned int t) {
+        size_t begin = count * t / num_threads;
+        size_t end = count * (t + 1) / num_threads;
+        for (size_t i = begin; i < end; i++) {
+            IndexRandom rng(seed, i);
+            Boid& b = boids[i];
+            switch (layout) {
+                case InitialLayout::Uniform:
+                    b.x = rng.uniform(0, params.width);
+                    b.y = rng.uniform(0, params.height);
+                    b.vx = rng.uniform(-2, 2);
+                    b.vy = rng.uniform(-2, 2);
+                    break;
+                case InitialLayout::Clusters: {
+                    const Blob& c = clusters[mix64(seed ^ i) % INITIAL_CLUSTERS];
+                    b.x = c.x + rng.gaussian() * 2 * params.visual_range;
+                    b.y = c.y + rng.gaussian() * 2 * params.visual_range;
+                    b.vx = rng.uniform(-2, 2);
+                    b.vy = rng.uniform(-2, 2);
+                    break;
+                }
+                case InitialLayout::Lattice:
+                    b.x = ((i % cols) + 0.5f) * params.width / cols;
+                    b.y = ((i / cols) + 0.5f) * params.height / rows;
+                    b.vx = rng.uniform(-2, 2);
+                    b.vy = rng.uniform(-2, 2);
+                    break;
+                case InitialLayout::Ring: {
+                    float angle = TWO_PI * i / count;
+                    float radius = ring_radius + rng.gaussian() * params.protected_range;
+                    b.x = 0.5f * params.width + radius * std::cos(angle);
+                    b.y = 0.5f * params.height + radius * std::sin(angle);
+                    b.vx = -std::sin(angle) * cruise;
+                    b.vy = std::cos(angle) * cruise;
+                    break;
+                }
+                case InitialLayout::Flocks: {
+                    const Blob& f = flocks[mix64(seed ^ i) % INITIAL_FLOCKS];
+                    b.x = f.x + rng.gaussian() * params.visual_range;
+                    b.y = f.y + rng.gaussian() * params.visual_range;
+                    b.vx = std::cos(f.heading) * cruise + rng.gaussian();
+                    b.vy = std::sin(f.heading) * cruise + rng.gaussian();
+                    break;
+                }
+            }
+            b.biasval = 0.0f;
+            b.scout_group = (i < 10) ? 1 : (i < 20) ? 2 : 0;
+        }
+    });
+}
+
+bool save_state(const std::string& path, const BoidVector& boids, uint64_t step) {
+    std::unique_ptr<TrajectorySink> sink = open_file_sink(path);
+    if (!sink) return false;
+    bool ok = write_checkpoint(*sink, boids, step);
+    return sink->close() && ok;
+}
+
+namespace {
+
+bool valid_header(const CheckpointHeader& header, size_t file_bytes) {
+    return header.magic == CHECKPOINT_MAGIC && header.version == CHECKPOINT_VERSION &&
+           header.record_bytes == sizeof(Boid) &&
+           header.count <= (file_bytes - sizeof(header)) / sizeof(Boid);
+}
+
+} // namespace
+
+#if defined(BOIDS_HAVE_MMAP)
+bool load_state(WorkerPool& pool, const std::string& path, BoidVector& boids, uint64_t* step) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t file_bytes = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, file_bytes, MADV_WILLNEED);
+
+    const char* base = static_cast<const char*>(mapping);
+    CheckpointHeader header;
+    memcpy(&header, base, sizeof(header));
+    bool ok = valid_header(header, file_bytes);
+    if (ok) {
+        size_t count = static_cast<size_t>(header.count);
+        boids.clear();
+        boids.resize(count);
+        const char* records = base + sizeof(header);
+        // Each thread faults in and copies its own slice of the file
+        unsigned int num_threads = pool.size();
+        pool.run([&](unsigned int t) {
+            size_t begin = count * t / num_threads;
+            size_t end = count * (t + 1) / num_threads;
+            if (end > begin) memcpy(&boids[begin], records + begin * sizeof(Boid), (end - begin) * sizeof(Boid));
+        });
+        if (step) *step = header.step;
+    }
+    munmap(mapping, file_bytes);
+    return ok;
+}
+#else
+// Without mmap the file is read in one go on the calling thread
+bool load_state(WorkerPool&, const std::string& path, BoidVector& boids, uint64_t* step) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long file_bytes = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    CheckpointHeader header;
+    bool ok = file_bytes >= static_cast<long>(sizeof(header)) && fread(&header, sizeof(header), 1, file) == 1 &&
+              valid_header(header, static_cast<size_t>(file_bytes));
+    if (ok) {
+        boids.resize(static_cast<size_t>(header.count));
+        ok = fread(boids.data(), sizeof(Boid), boids.size(), file) == boids.size();
+        if (ok && step) *step = header.step;
+    }
+    fclose(file);
+    return ok;
+}
+#endif
@@ -0,0 +1,75 @@
+//
+// Parallel initial-condition generators and memory-mapped state loading.
+//
+
+#ifndef INITIAL_STATE_H
+#define INITIAL_STATE_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Gaussian clusters and pre-formed flocks the generators scatter over the world
+#define INITIAL_CLUSTERS 8
+#define INITIAL_FLOCKS 16
+
+#define TWO_PI 6.28318530718f
+
+inline uint64_t mix64(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Counter-based generator: the draws for one index do not depend on any
+// other index, so threads can fill disjoint ranges without shared state
+struct IndexRandom {
+    uint64_t state;
+
+    IndexRandom(uint64_t seed, uint64_t index) : state(mix64(seed ^ mix64(index))) {}
+
+    float uniform(float min, float max) {
+        state = mix64(state);
+        return min + static_cast<float>(state >> 40) * (1.0f / 16777216.0f) * (max - min);
+    }
+
+    // Box-Muller, one of the pair is enough here
+    float gaussian() {
+        float u1 = uniform(0.0f, 1.0f);
+        float u2 = uniform(0.0f, 1.0f);
+        return std::sqrt(-2.0f * std::log(1.0f - u1)) * std::cos(TWO_PI * u2);
+    }
+};
+
+enum class InitialLayout {
+    Uniform,  // positions and velocities uniform over the world, like the windowed programs
+    Clusters, // Gaussian blobs with random velocities
+    Lattice,  // regular grid covering the world
+    Ring,     // one ring around the centre, rotating at cruise speed
+    Flocks    // Gaussian blobs already moving together along a shared heading
+};
+
+const char* layout_name(InitialLayout layout);
+// Accepts the names returned by layout_name()
+bool parse_layout(const char* name, InitialLayout* layout);
+
+// Fills boids with count boids laid out as requested. Every boid is a pure
+// function of (seed, index), so the result is identical for any pool size
+// and benchmarks start from the same state. The first 10 boids bias right
+// and the next 10 bias left, as in the windowed programs.
+void generate_boids(WorkerPool& pool, BoidVector& boids, InitialLayout layout, size_t count,
+                    uint64_t seed, const BoidParams& params = DEFAULT_PARAMS);
+
+// Saves boids as a checkpoint file (see checkpoint.h)
+bool save_state(const std::string& path, const BoidVector& boids, uint64_t step = 0);
+
+// Maps a checkpoint file and copies the boids out of it on all threads of
+// the pool. Returns false if the file is missing or not a checkpoint of
+// this build's Boid layout.
+bool load_state(WorkerPool& pool, const std::string& path, BoidVector& boids, uint64_t* step = nullptr);
+
+#endif //INITIAL_STATE_H
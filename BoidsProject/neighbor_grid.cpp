@@ -0,0 +1,150 @@
+#include "neighbor_grid.h"
+
+#include <cmath>
+
+#include "boid_rules.h"
+
+void UniformGrid::build(const BoidVector& boids, float cell_size) {
+    int n = static_cast<int>(boids.size());
+    float min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+    if (n > 0) {
+        min_x = max_x = boids[0].x;
+        min_y = max_y = boids[0].y;
+    }
+    for (const auto& b : boids) {
+        min_x = std::min(min_x, b.x);
+        max_x = std::max(max_x, b.x);
+        min_y = std::min(min_y, b.y);
+        max_y = std::max(max_y, b.y);
+    }
+
+    // Boids can stray far outside the world before the boundary turn brings
+    // them back, so the extent comes from the boids rather than the params
+    // Also catches NaN, which fails every comparison
+    cell_size_ = cell_size > GRID_MIN_CELL_SIZE ? cell_size : GRID_MIN_CELL_SIZE;
+    do {
+        cols_ = static_cast<int>((max_x - min_x) / cell_size_) + 1;
+        rows_ = static_cast<int>((max_y - min_y) / cell_size_) + 1;
+        if (static_cast<long long>(cols_) * rows_ <= GRID_MAX_CELLS) break;
+        cell_size_ *= 2.0f;
+    } while (true);
+    inv_cell_size_ = 1.0f / cell_size_;
+    origin_x_ = min_x;
+    origin_y_ = min_y;
+
+    int cells = cols_ * rows_;
+    cell_start_.assign(cells + 1, 0);
+    cell_of_boid_.resize(n);
+    for (int i = 0; i < n; i++) {
+        int c = cell_of(boids[i].y, origin_y_, rows_) * cols_ + cell_of(boids[i].x, origin_x_, cols_);
+        cell_of_boid_[i] = c;
+        cell_start_[c + 1]++;
+    }
+    for (int c = 0; c < cells; c++) cell_start_[c + 1] += cell_start_[c];
+
+    // Stable scatter, so each cell lists its boids in index order
+    indices_.resize(n);
+    std::vector<int> fill(cell_start_.begin(), cell_start_.end() - 1);
+    for (int i = 0; i < n; i++) indices_[fill[cell_of_boid_[i]]++] = i;
+}
+
+void HierarchicalGrid::build(const BoidVector& boids, float deltaTime, const BoidParams& params,
+                             const BoidAttributes& attrs) {
+    float fastest = params.max_speed;
+    ranges_.clear();
+    // A boid that sees nothing needs no level of its own; any level serves it
+    if (attrs.empty()) {
+        if (params.visual_range > 0.0f) ranges_.push_back(params.visual_range);
+    } else {
+        fastest = *std::max_element(attrs.max_speed.begin(), attrs.max_speed.end());
+        // Distinct positive ranges, giving up as soon as there are more than levels
+        bool too_many = false;
+        for (float range : attrs.visual_range) {
+            if (!(range > 0.0f)) continue;
+            if (std::find(ranges_.begin(), ranges_.end(), range) != ranges_.end()) continue;
+            if (ranges_.size() == max_levels_) {
+                too_many = true;
+                break;
+            }
+            ranges_.push_back(range);
+        }
+        if (too_many) {
+            // Geometric steps from the shortest positive range to the longest
+            float shortest = ranges_.front();
+            for (float range : attrs.visual_range) {
+                if (range > 0.0f && range < shortest) shortest = range;
+            }
+            float longest = attrs.max_visual_range(params);
+            ranges_.clear();
+            for (unsigned int l = 1; l <= max_levels_; l++)
+                ranges_.push_back(shortest * std::pow(longest / shortest, static_cast<float>(l) / max_levels_));
+            ranges_.back() = longest;
+        }
+        std::sort(ranges_.begin(), ranges_.end());
+    }
+    if (ranges_.empty()) ranges_.push_back(GRID_MIN_CELL_SIZE);
+
+    float slack = fastest * deltaTime;
+    levels_.resize(ranges_.size());
+    for (size_t l = 0; l < ranges_.size(); l++) levels_[l].build(boids, ranges_[l] + slack);
+}
+
+const UniformGrid& HierarchicalGrid::level_for(float range) const {
+    for (size_t l = 0; l < ranges_.size(); l++) {
+        if (ranges_[l] >= range) return levels_[l];
+    }
+    return levels_.back();
+}
+
+template <bool PerBoid, bool Fov, bool Ttc, typename Sum>
+static void update_slice_grid(const HierarchicalGrid& grid, BoidVector& boids, int start_idx, int end_idx,
+                              float deltaTime, const BoidParams& params, const BoidAttributes& attrs) {
+    const Lookahead ahead = lookahead(params);
+    for (int i = start_idx; i < end_idx; i++) {
+        auto& boid = boids[i];
+        const float visual_range = PerBoid ? attrs.visual_range[i] : params.visual_range;
+        const float min_speed = PerBoid ? attrs.min_speed[i] : params.min_speed;
+        const float max_speed = PerBoid ? attrs.max_speed[i] : params.max_speed;
+        const ViewCone cone = Fov ? view_cone(boid, params) : ViewCone();
+        NeighborSums<Sum> sums;
+
+        auto visit = [&](int j) {
+            if (j != i) {
+                accumulate_neighbor<Fov, Ttc>(boid, boids[j], visual_range, params.protected_range, sums, cone, ahead);
+            }
+        };
+        const UniformGrid& level = grid.level_for(visual_range);
+        if (params.max_neighbors > 0) {
+            int stride = level.for_each_near_sampled(boid.x, boid.y, params.max_neighbors * SAMPLE_CANDIDATES_PER_NEIGHBOR,
+                                                     static_cast<unsigned int>(i), visit);
+            // Cohesion and alignment are averages and need no correction;
+            // the separation and collision pushes are sums, so scale them back up
+            sums.close_dx *= stride;
+            sums.close_dy *= stride;
+            sums.avoid_dx *= stride;
+            sums.avoid_dy *= stride;
+        } else {
+            level.for_each_near(boid.x, boid.y, visit);
+        }
+
+        steer_boid(boid, sums, deltaTime, params, min_speed, max_speed);
+    }
+}
+
+void update_boids_grid(WorkerPool& pool, HierarchicalGrid& grid, BoidVector& boids, float deltaTime,
+                       const BoidParams& params, const BoidAttributes& attrs) {
+    grid.build(boids, deltaTime, params, attrs);
+
+    unsigned int num_threads = pool.size();
+    int batch_size = boids.size() / num_threads;
+
+    pool.run([&](unsigned int t) {
+        int start_idx = t * batch_size;
+        int end_idx = (t == num_threads - 1) ? boids.size() : (t + 1) * batch_size;
+        dispatch_kernel(!attrs.empty(), fov_enabled(params), ttc_enabled(params), params.accumulator,
+                        [&](auto per_boid_t, auto fov_t, auto ttc_t, auto sum_t) {
+            update_slice_grid<per_boid_t.value, fov_t.value, ttc_t.value, decltype(sum_t)>(
+                grid, boids, start_idx, end_idx, deltaTime, params, attrs);
+        });
+    });
+}
@@ -0,0 +1,138 @@
+//
+// Uniform and multi-level cell grids that limit the neighbour search to
+// the cells around each boid.
+//
+
+#ifndef NEIGHBOR_GRID_H
+#define NEIGHBOR_GRID_H
+
+#include <algorithm>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Most levels a HierarchicalGrid builds; more distinct ranges share levels
+#define GRID_MAX_LEVELS 4
+// Cap on the cells of one level, the cell size grows to stay below it
+#define GRID_MAX_CELLS (1 << 22)
+// Smallest cell a level uses, for a range of 0 with no slack to pad it
+#define GRID_MIN_CELL_SIZE 1.0f
+// Candidates sampled per wanted neighbour under max_neighbors: the 3x3
+// block is 9 r^2 against pi r^2 for the disc, so about a third are in range
+#define SAMPLE_CANDIDATES_PER_NEIGHBOR 3
+
+// Boids bucketed into square cells with a counting sort. Cells are at
+// least as wide as the range they serve, so every boid within that range
+// of a point lies in the 3x3 block of cells around it.
+class UniformGrid {
+public:
+    void build(const BoidVector& boids, float cell_size);
+
+    float cell_size() const { return cell_size_; }
+
+    // Calls fn(j) for every boid j binned in the 3x3 cells around (x, y)
+    template <typename Fn>
+    void for_each_near(float x, float y, Fn&& fn) const {
+        int cx = cell_of(x, origin_x_, cols_);
+        int cy = cell_of(y, origin_y_, rows_);
+        for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, rows_ - 1); gy++) {
+            // Cells of a row are contiguous, so the three of them are one range
+            int first = gy * cols_ + std::max(cx - 1, 0);
+            int last = gy * cols_ + std::min(cx + 1, cols_ - 1);
+            for (int k = cell_start_[first]; k < cell_start_[last + 1]; k++) fn(indices_[k]);
+        }
+    }
+
+    // Like for_each_near, but when the block holds more than budget boids
+    // only every stride-th one is visited, starting at seed % stride.
+    // The block is walked cell by cell, so every cell contributes in
+    // proportion to its population. Returns the stride, 1 when all were visited.
+    template <typename Fn>
+    int for_each_near_sampled(float x, float y, int budget, unsigned int seed, Fn&& fn) const {
+        int cx = cell_of(x, origin_x_, cols_);
+        int cy = cell_of(y, origin_y_, rows_);
+        int row_begin[3], row_end[3], row_count = 0, total = 0;
+        for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, rows_ - 1); gy++) {
+            row_begin[row_count] = cell_start_[gy * cols_ + std::max(cx - 1, 0)];
+            row_end[row_count] = cell_start_[gy * cols_ + std::min(cx + 1, cols_ - 1) + 1];
+            total += row_end[row_count] - row_begin[row_count];
+            row_count++;
+        }
+        int stride = total > budget ? (total + budget - 1) / budget : 1;
+        // Position of the next sample in the concatenated rows
+        int next = static_cast<int>(seed % static_cast<unsigned int>(stride));
+        int passed = 0;
+        for (int r = 0; r < row_count; r++) {
+            int len = row_end[r] - row_begin[r];
+            for (; next < passed + len; next += stride) fn(indices_[row_begin[r] + next - passed]);
+            passed += len;
+        }
+        return stride;
+    }
+
+    // Calls fn(j) for every boid binned in the cells overlapping the square
+    // of half-width half around (x, y). The rows of that block are split
+    // into parts slices and only slice part is visited, so threads can share
+    // one query without visiting a boid twice.
+    template <typename Fn>
+    void for_each_in_box(float x, float y, float half, unsigned int part, unsigned int parts, Fn&& fn) const {
+        int x0 = cell_of(x - half, origin_x_, cols_), x1 = cell_of(x + half, origin_x_, cols_);
+        int y0 = cell_of(y - half, origin_y_, rows_), y1 = cell_of(y + half, origin_y_, rows_);
+        // All in int: a box with no rows gives every part an empty slice
+        int rows = y1 - y0 + 1;
+        int p = static_cast<int>(part), n = static_cast<int>(parts);
+        int begin = y0 + rows * p / n, end = y0 + rows * (p + 1) / n;
+        for (int gy = begin; gy < end; gy++) {
+            for (int k = cell_start_[gy * cols_ + x0]; k < cell_start_[gy * cols_ + x1 + 1]; k++) fn(indices_[k]);
+        }
+    }
+
+private:
+    int cell_of(float v, float origin, int cells) const {
+        int c = static_cast<int>((v - origin) * inv_cell_size_);
+        return std::min(std::max(c, 0), cells - 1);
+    }
+
+    float cell_size_ = 1.0f;
+    float inv_cell_size_ = 1.0f;
+    float origin_x_ = 0.0f, origin_y_ = 0.0f;
+    int cols_ = 1, rows_ = 1;
+    std::vector<int> cell_start_; // boids of cell c are indices_[cell_start_[c] .. cell_start_[c + 1])
+    std::vector<int> indices_;
+    std::vector<int> cell_of_boid_;
+};
+
+// One UniformGrid per distinct visual range in use. Every level holds all
+// boids, and each boid searches the finest level that covers its own
+// range, so boids with a short range scan small cells even when a few
+// others look much further. With max_levels 1 this is a single grid sized
+// for the largest range.
+class HierarchicalGrid {
+public:
+    explicit HierarchicalGrid(unsigned int max_levels = GRID_MAX_LEVELS) : max_levels_(max_levels ? max_levels : 1) {}
+
+    // Picks the levels for the ranges in params or attrs and rebins the boids.
+    // Cells get max_speed * deltaTime of slack because the boids move while
+    // the step that searches them is still running.
+    void build(const BoidVector& boids, float deltaTime, const BoidParams& params,
+               const BoidAttributes& attrs);
+
+    unsigned int levels() const { return static_cast<unsigned int>(levels_.size()); }
+    // Finest level whose cells cover range
+    const UniformGrid& level_for(float range) const;
+    // Level with the largest cells, only valid after build()
+    const UniformGrid& coarsest() const { return levels_.back(); }
+
+private:
+    unsigned int max_levels_;
+    std::vector<float> ranges_; // largest visual range each level serves, ascending
+    std::vector<UniformGrid> levels_;
+};
+
+// update_boids_parallel on a grid: rebuilds it, then every boid only visits
+// the cells around it on the level of its own visual range. With
+// params.max_neighbors set, crowded boids sample their candidates instead.
+void update_boids_grid(WorkerPool& pool, HierarchicalGrid& grid, BoidVector& boids, float deltaTime,
+                       const BoidParams& params = DEFAULT_PARAMS, const BoidAttributes& attrs = BoidAttributes());
+
+#endif //NEIGHBOR_GRID_H
@@ -0,0 +1,182 @@
+#include "particle_in_cell.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "boid_rules.h"
+
+std::vector<std::pair<int, int>> ParticleInCell::disc_offsets(float radius) {
+    std::vector<std::pair<int, int>> offsets;
+    int reach = static_cast<int>(radius);
+    for (int dy = -reach; dy <= reach; dy++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+            if (dx*dx + dy*dy <= radius*radius) offsets.emplace_back(dx, dy);
+        }
+    }
+    return offsets;
+}
+
+bool ParticleInCell::layout(const BoidVector& boids, const BoidParams& params) {
+    float range = params.visual_range;
+    if (!(range > 0.0f)) return false;
+    float min_x = 0.0f, min_y = 0.0f, max_x = params.width, max_y = params.height;
+    for (const auto& b : boids) {
+        min_x = std::min(min_x, b.x);
+        max_x = std::max(max_x, b.x);
+        min_y = std::min(min_y, b.y);
+        max_y = std::max(max_y, b.y);
+    }
+
+    // A range of margin on every side keeps the whole disc of any boid on the grid
+    cell_size_ = node_spacing_ > 0 ? std::min(node_spacing_, range / 2) : range / cells_per_range_;
+    do {
+        origin_x_ = min_x - range - cell_size_;
+        origin_y_ = min_y - range - cell_size_;
+        cols_ = static_cast<int>((max_x - origin_x_ + range) / cell_size_) + 2;
+        rows_ = static_cast<int>((max_y - origin_y_ + range) / cell_size_) + 2;
+        if (static_cast<long long>(cols_) * rows_ <= GRID_MAX_CELLS) break;
+        if (range / (2.0f * cell_size_) < PIC_MIN_RADIUS) return false;
+        cell_size_ *= 2.0f;
+    } while (true);
+
+    float radius = range / cell_size_;
+    if (radius != disc_radius_) {
+        disc_ = disc_offsets(radius);
+        disc_radius_ = radius;
+    }
+    return true;
+}
+
+void ParticleInCell::deposit(WorkerPool& pool, const BoidVector& boids) {
+    unsigned int num_threads = pool.size();
+    size_t values = static_cast<size_t>(cols_) * rows_ * PIC_FIELDS;
+    deposits_.resize(values * num_threads);
+    summed_.resize(values);
+    size_t count = boids.size();
+    float inv_cell = 1.0f / cell_size_;
+
+    pool.run([&](unsigned int t) {
+        float* grid = &deposits_[values * t];
+        std::fill(grid, grid + values, 0.0f);
+        size_t begin = count * t / num_threads;
+        size_t end = count * (t + 1) / num_threads;
+        for (size_t i = begin; i < end; i++) {
+            const Boid& b = boids[i];
+            float gx = (b.x - origin_x_) * inv_cell;
+            float gy = (b.y - origin_y_) * inv_cell;
+            int ix = static_cast<int>(gx);
+            int iy = static_cast<int>(gy);
+            float fx = gx - ix;
+            float fy = gy - iy;
+            const float weights[4] = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+            const int nodes[4] = {iy * cols_ + ix, iy * cols_ + ix + 1, (iy + 1) * cols_ + ix, (iy + 1) * cols_ + ix + 1};
+            for (int k = 0; k < 4; k++) {
+                float* node = grid + static_cast<size_t>(nodes[k]) * PIC_FIELDS;
+                node[0] += weights[k];
+                node[1] += weights[k] * b.x;
+                node[2] += weights[k] * b.y;
+                node[3] += weights[k] * b.vx;
+                node[4] += weights[k] * b.vy;
+            }
+        }
+    });
+
+    // Sum the per-thread grids, each thread owning a slice of the nodes
+    pool.run([&](unsigned int t) {
+        size_t begin = values * t / num_threads;
+        size_t end = values * (t + 1) / num_threads;
+        for (size_t k = begin; k < end; k++) {
+            float sum = 0.0f;
+            for (unsigned int s = 0; s < num_threads; s++) sum += deposits_[values * s + k];
+            summed_[k] = sum;
+        }
+    });
+}
+
+void ParticleInCell::smooth(WorkerPool& pool, const BoidParams&) {
+    unsigned int num_threads = pool.size();
+    smoothed_.resize(summed_.size());
+
+    // Direct sum over the disc, O(nodes * disc)
+    pool.run([&](unsigned int t) {
+        int row_begin = rows_ * t / num_threads;
+        int row_end = rows_ * (t + 1) / num_threads;
+        for (int y = row_begin; y < row_end; y++) {
+            for (int x = 0; x < cols_; x++) {
+                float acc[PIC_FIELDS] = {0, 0, 0, 0, 0};
+                for (const auto& o : disc_) {
+                    int sx = x + o.first;
+                    int sy = y + o.second;
+                    if (sx < 0 || sx >= cols_ || sy < 0 || sy >= rows_) continue;
+                    const float* node = &summed_[(static_cast<size_t>(sy) * cols_ + sx) * PIC_FIELDS];
+                    for (int f = 0; f < PIC_FIELDS; f++) acc[f] += node[f];
+                }
+                float* out = &smoothed_[(static_cast<size_t>(y) * cols_ + x) * PIC_FIELDS];
+                for (int f = 0; f < PIC_FIELDS; f++) out[f] = acc[f];
+            }
+        }
+    });
+}
+
+void ParticleInCell::interact(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params,
+                              const BoidAttributes& attrs) {
+    float fastest = attrs.empty() ? params.max_speed : *std::max_element(attrs.max_speed.begin(), attrs.max_speed.end());
+    separation_grid_.build(boids, params.protected_range + fastest * deltaTime);
+
+    unsigned int num_threads = pool.size();
+    int count = static_cast<int>(boids.size());
+    float inv_cell = 1.0f / cell_size_;
+
+    pool.run([&](unsigned int t) {
+        int begin = count * t / num_threads;
+        int end = count * (t + 1) / num_threads;
+        for (int i = begin; i < end; i++) {
+            auto& boid = boids[i];
+            const float min_speed = attrs.empty() ? params.min_speed : attrs.min_speed[i];
+            const float max_speed = attrs.empty() ? params.max_speed : attrs.max_speed[i];
+
+            // Bilinear read of the smoothed sums at the boid
+            float gx = (boid.x - origin_x_) * inv_cell;
+            float gy = (boid.y - origin_y_) * inv_cell;
+            int ix = static_cast<int>(gx);
+            int iy = static_cast<int>(gy);
+            float fx = gx - ix;
+            float fy = gy - iy;
+            const float weights[4] = {(1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy};
+            const int nodes[4] = {iy * cols_ + ix, iy * cols_ + ix + 1, (iy + 1) * cols_ + ix, (iy + 1) * cols_ + ix + 1};
+            float sample[PIC_FIELDS] = {0, 0, 0, 0, 0};
+            for (int k = 0; k < 4; k++) {
+                const float* node = &smoothed_[static_cast<size_t>(nodes[k]) * PIC_FIELDS];
+                for (int f = 0; f < PIC_FIELDS; f++) sample[f] += weights[k] * node[f];
+            }
+
+            // The disc spans more than the four deposit nodes, so the boid's
+            // own share of every sum is exactly its own weight of 1
+            // Float sums: the field already did the long summation
+            NeighborSums<> sums;
+            float others = sample[0] - 1.0f;
+            if (others > PIC_MIN_WEIGHT) {
+                sums.xpos_avg = (sample[1] - boid.x) / others;
+                sums.ypos_avg = (sample[2] - boid.y) / others;
+                sums.xvel_avg = (sample[3] - boid.vx) / others;
+                sums.yvel_avg = (sample[4] - boid.vy) / others;
+                sums.neighboring_boids = 1; // already averages
+            }
+
+            separation_grid_.for_each_near(boid.x, boid.y, [&](int j) {
+                if (j != i) accumulate_neighbor(boid, boids[j], params.protected_range, params.protected_range, sums);
+            });
+
+            steer_boid(boid, sums, deltaTime, params, min_speed, max_speed);
+        }
+    });
+}
+
+bool ParticleInCell::step(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params,
+                          const BoidAttributes& attrs) {
+    if (!layout(boids, params)) return false;
+    deposit(pool, boids);
+    smooth(pool, params);
+    interact(pool, boids, deltaTime, params, attrs);
+    return true;
+}
@@ -0,0 +1,89 @@
+//
+// Particle-in-cell interaction engine: alignment and cohesion come from a
+// smoothed velocity field on a grid instead of from neighbour pairs.
+//
+
+#ifndef PARTICLE_IN_CELL_H
+#define PARTICLE_IN_CELL_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "boids_parallel.h"
+#include "neighbor_grid.h"
+
+// Grid nodes per visual range, at least 2; the smoothing disc spans this many nodes
+#define PIC_CELLS_PER_RANGE 4
+// Smallest disc radius in nodes. Below it the disc no longer covers the
+// four nodes a boid deposits on, and its own share cannot be taken out.
+#define PIC_MIN_RADIUS 2.0f
+// Smoothed neighbour weight below which a boid counts as alone
+#define PIC_MIN_WEIGHT 0.5f
+// Count, x, y, vx and vy per node
+#define PIC_FIELDS 5
+
+// Every step the boids deposit count, position and velocity onto grid
+// nodes with cloud-in-cell (bilinear) weights, each thread into its own
+// copy of the grid, and the copies are summed. A disc of radius
+// visual_range smooths the sums, so a node holds the totals of the boids
+// within range of it, and each boid reads its cohesion and alignment
+// targets back with the same bilinear weights after removing its own
+// share. Separation stays exact and local on a UniformGrid of
+// protected_range cells. The cost is O(N + nodes * disc) however dense
+// the flock gets.
+//
+// The field is isotropic and uses params.visual_range for everyone, so
+// the field of view and per-boid visual ranges do not apply to cohesion
+// and alignment here; per-boid speed limits still do. The separation grid
+// only reaches protected_range, too short for the time-to-collision rule,
+// which is left out.
+class ParticleInCell {
+public:
+    explicit ParticleInCell(int cells_per_range = PIC_CELLS_PER_RANGE)
+        : cells_per_range_(std::max(cells_per_range, 2)) {}
+    virtual ~ParticleInCell() = default;
+
+    // False, leaving the boids as they were, when the grid cannot resolve
+    // the visual range: a range of 0, or a world so large that the cell cap
+    // pushes the disc below PIC_MIN_RADIUS nodes
+    bool step(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params = DEFAULT_PARAMS,
+              const BoidAttributes& attrs = BoidAttributes());
+
+    // Fixed distance between nodes instead of visual_range / cells_per_range,
+    // capped at half the range; 0 goes back to following the range
+    void set_node_spacing(float spacing) { node_spacing_ = spacing; }
+
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+    float cell_size() const { return cell_size_; }
+    // Smoothed node values, PIC_FIELDS floats per node in row-major order
+    const std::vector<float>& field() const { return smoothed_; }
+    // Boids binned by protected_range at the start of the last step's moves
+    const UniformGrid& separation_grid() const { return separation_grid_; }
+
+    // Offsets of the nodes within radius cells of the centre, the smoothing disc
+    static std::vector<std::pair<int, int>> disc_offsets(float radius);
+
+protected:
+    // Picks the node spacing and the extent of the grid for this step
+    bool layout(const BoidVector& boids, const BoidParams& params);
+    void deposit(WorkerPool& pool, const BoidVector& boids);
+    virtual void smooth(WorkerPool& pool, const BoidParams& params);
+    void interact(WorkerPool& pool, BoidVector& boids, float deltaTime, const BoidParams& params,
+                  const BoidAttributes& attrs);
+
+    int cells_per_range_;
+    float node_spacing_ = 0.0f;
+    float cell_size_ = 1.0f;
+    float origin_x_ = 0.0f, origin_y_ = 0.0f;
+    int cols_ = 1, rows_ = 1;
+    std::vector<float> deposits_; // one grid per thread
+    std::vector<float> summed_;
+    std::vector<float> smoothed_;
+    std::vector<std::pair<int, int>> disc_;
+    float disc_radius_ = -1.0f;
+    UniformGrid separation_grid_;
+};
+
+#endif //PARTICLE_IN_CELL_H
@@ -0,0 +1,139 @@
+#include "population.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "initial_state.h"
+
+bool Population::absorbed(const Boid& b) const {
+    for (const auto& a : absorbers_) {
+        float dx = b.x - a.x;
+        float dy = b.y - a.y;
+        if (dx*dx + dy*dy < a.radius*a.radius) return true;
+    }
+    return false;
+}
+
+void Population::reserve(BoidVector& boids, size_t capacity) {
+    boids.reserve(capacity);
+    spare_.reserve(capacity);
+}
+
+PopulationChange Population::update(WorkerPool& pool, BoidVector& boids, float deltaTime,
+                                    BoidAttributes* attrs, const BoidParams& params, std::vector<int>* new_index) {
+    PopulationChange change;
+    if (!active()) return change;
+    if (attrs && attrs->empty()) attrs = nullptr;
+
+    unsigned int num_threads = pool.size();
+    size_t count = boids.size();
+    kept_.assign(num_threads, 0);
+
+    // Pass 1: survivors in each thread's slice
+    if (!absorbers_.empty()) {
+        pool.run([&](unsigned int t) {
+            size_t begin = count * t / num_threads;
+            size_t end = count * (t + 1) / num_threads;
+            size_t kept = 0;
+            for (size_t i = begin; i < end; i++) {
+                if (!absorbed(boids[i])) kept++;
+            }
+            kept_[t] = kept;
+        });
+    } else {
+        for (unsigned int t = 0; t < num_threads; t++)
+            kept_[t] = count * (t + 1) / num_threads - count * t / num_threads;
+    }
+
+    // Exclusive scan of the survivor counts gives every thread its output offset
+    size_t survivors = 0;
+    for (unsigned int t = 0; t < num_threads; t++) {
+        size_t kept = kept_[t];
+        kept_[t] = survivors;
+        survivors += kept;
+    }
+    change.absorbed = count - survivors;
+
+    // New boids go after the survivors, emitter by emitter
+    emit_first_.resize(emitters_.size() + 1);
+    size_t total = survivors;
+    for (size_t e = 0; e < emitters_.size(); e++) {
+        Emitter& emitter = emitters_[e];
+        emitter.carry += emitter.rate * deltaTime;
+        size_t n = static_cast<size_t>(emitter.carry);
+        emitter.carry -= static_cast<float>(n);
+        emit_first_[e] = total;
+        total += n;
+    }
+    emit_first_[emitters_.size()] = total;
+    change.emitted = total - survivors;
+
+    if (change.absorbed == 0 && change.emitted == 0) {
+        updates_++;
+        return change;
+    }
+
+    // spare_ still holds the generation before last, which nobody reads:
+    // drop it so growing the buffer does not copy it. Neither resize writes
+    // anything; pass 2 fills every survivor and newborn in parallel.
+    spare_.clear();
+    if (total > spare_.capacity()) spare_.reserve(std::max(total, 2 * spare_.capacity()));
+    spare_.resize(total);
+    if (attrs) {
+        spare_attrs_.clear();
+        spare_attrs_.resize_unset(total);
+    }
+    if (change.absorbed == 0) new_index = nullptr;
+    if (new_index) new_index->resize(count);
+
+    // Pass 2: compact the survivors and create the new boids
+    uint64_t update_seed = seed_ ^ mix64(updates_);
+    size_t emitted = change.emitted;
+    pool.run([&](unsigned int t) {
+        size_t begin = count * t / num_threads;
+        size_t end = count * (t + 1) / num_threads;
+        size_t out = kept_[t];
+        for (size_t i = begin; i < end; i++) {
+            if (!absorbers_.empty() && absorbed(boids[i])) {
+                if (new_index) (*new_index)[i] = -1;
+                continue;
+            }
+            if (new_index) (*new_index)[i] = static_cast<int>(out);
+            spare_[out] = boids[i];
+            if (attrs) {
+                spare_attrs_.visual_range[out] = attrs->visual_range[i];
+                spare_attrs_.min_speed[out] = attrs->min_speed[i];
+                spare_attrs_.max_speed[out] = attrs->max_speed[i];
+            }
+            out++;
+        }
+
+        size_t first = survivors + emitted * t / num_threads;
+        size_t last = survivors + emitted * (t + 1) / num_threads;
+        size_t e = std::upper_bound(emit_first_.begin(), emit_first_.end(), first) - emit_first_.begin() - 1;
+        for (size_t k = first; k < last; k++) {
+            while (k >= emit_first_[e + 1]) e++;
+            const Emitter& emitter = emitters_[e];
+            IndexRandom rng(update_seed, k);
+            float r = emitter.radius * std::sqrt(rng.uniform(0.0f, 1.0f));
+            float angle = rng.uniform(0.0f, TWO_PI);
+            Boid& b = spare_[k];
+            b.x = emitter.x + r * std::cos(angle);
+            b.y = emitter.y + r * std::sin(angle);
+            b.vx = emitter.vx + rng.uniform(-2, 2);
+            b.vy = emitter.vy + rng.uniform(-2, 2);
+            b.biasval = 0.0f;
+            b.scout_group = emitter.scout_group;
+            if (attrs) {
+                spare_attrs_.visual_range[k] = params.visual_range;
+                spare_attrs_.min_speed[k] = params.min_speed;
+                spare_attrs_.max_speed[k] = params.max_speed;
+            }
+        }
+    });
+
+    boids.swap(spare_);
+    if (attrs) std::swap(*attrs, spare_attrs_);
+    updates_++;
+    return change;
+}
@@ -0,0 +1,76 @@
+//
+// Sources and sinks of boids: emitter regions that spawn them and absorber
+// regions that remove them, applied with a parallel stream compaction.
+//
+
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Spawns rate boids per second uniformly inside a disc
+struct Emitter {
+    float x, y, radius;
+    float rate;
+    float vx = 0.0f, vy = 0.0f; // mean initial velocity, spread by +-2 like the generators
+    int scout_group = 0;
+    float carry = 0.0f;         // fraction of a boid owed from earlier steps
+};
+
+// Removes every boid that ends a step inside the disc
+struct Absorber {
+    float x, y, radius;
+};
+
+struct PopulationChange {
+    size_t absorbed = 0;
+    size_t emitted = 0;
+};
+
+// Keeps the state dense while boids come and go. Each update is one
+// parallel pass that counts the survivors of every thread's slice, a scan
+// of those counts, and a second pass in which every thread copies its
+// survivors and its share of the new boids into a second buffer at the
+// scanned offset; the buffers are then swapped. Growth happens by
+// reserving the spare buffer before that copy, so a larger population
+// costs an allocation but never an extra copy of the state, and shrinking
+// keeps the capacity for the next burst.
+class Population {
+public:
+    explicit Population(uint64_t seed = 42) : seed_(seed) {}
+
+    void add_emitter(const Emitter& emitter) { emitters_.push_back(emitter); }
+    void add_absorber(const Absorber& absorber) { absorbers_.push_back(absorber); }
+    void clear() { emitters_.clear(); absorbers_.clear(); }
+    bool active() const { return !emitters_.empty() || !absorbers_.empty(); }
+
+    std::vector<Emitter>& emitters() { return emitters_; }
+    std::vector<Absorber>& absorbers() { return absorbers_; }
+
+    // Applies the absorbers and emitters for a step of deltaTime. Non-empty
+    // attrs are compacted along with the boids; new boids get params. When
+    // boids were absorbed, new_index[i] receives where boid i went, or -1.
+    PopulationChange update(WorkerPool& pool, BoidVector& boids, float deltaTime,
+                            BoidAttributes* attrs = nullptr, const BoidParams& params = DEFAULT_PARAMS,
+                            std::vector<int>* new_index = nullptr);
+
+    // Grows both buffers, so bursts up to capacity boids allocate nothing
+    void reserve(BoidVector& boids, size_t capacity);
+
+private:
+    bool absorbed(const Boid& b) const;
+
+    uint64_t seed_;
+    uint64_t updates_ = 0;
+    std::vector<Emitter> emitters_;
+    std::vector<Absorber> absorbers_;
+    BoidVector spare_;
+    BoidAttributes spare_attrs_;
+    std::vector<size_t> kept_;       // survivors per thread, then their output offsets
+    std::vector<size_t> emit_first_; // first new boid of each emitter
+};
+
+#endif //POPULATION_H
@@ -0,0 +1,166 @@
+// Records a headless run to a compressed trajectory and checks it reads back.
+// Usage: BoidsRecord <file> [num_boids] [steps] [keyframe_interval] [workers] [off|file|uring]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boids_world.h"
+#include "checkpoint.h"
+#include "trajectory.h"
+#include "uring_sink.h"
+
+#define RECORD_DT (1.0f / 60.0f)
+// Checkpoints written back to back through one sink
+#define RECORD_CHECKPOINTS 8
+
+// Largest position error of a decoded frame against the state it came from,
+// infinite if a scout group differs
+static float max_error(const TrajectoryFrame& frame, const BoidVector& boids) {
+    if (frame.x.size() != boids.size()) return INFINITY;
+    float worst = 0.0f;
+    for (size_t i = 0; i < boids.size(); i++) {
+        if (frame.scout_group[i] != boids[i].scout_group) return INFINITY;
+        worst = std::fmax(worst, std::fabs(frame.x[i] - boids[i].x));
+        worst = std::fmax(worst, std::fabs(frame.y[i] - boids[i].y));
+    }
+    return worst;
+}
+
+// Records two keyframe intervals of boids whose groups change between
+// keyframes, a few boids at a time and then all of them, and checks every
+// decoded frame against what was recorded
+static bool groups_round_trip(const std::string& path, BoidVector boids, const BoidParams& params,
+                              int keyframe_interval) {
+    int frames = 2 * std::max(2, keyframe_interval);
+    std::vector<BoidVector> recorded;
+    {
+        TrajectoryRecorder recorder(path, params, keyframe_interval, DEFAULT_QUANTUM, 1);
+        for (int f = 0; f < frames; f++) {
+            if (f == frames / 4) {
+                for (size_t i = 0; i < boids.size(); i += 7) boids[i].scout_group = (boids[i].scout_group + 1) % 3;
+            }
+            if (f == frames / 4 + 1) {
+                for (auto& b : boids) b.scout_group = 2;
+            }
+            recorder.record(boids, f);
+            recorded.push_back(boids);
+        }
+        recorder.close();
+        if (!recorder.ok()) return false;
+    }
+    TrajectoryReader reader(path);
+    TrajectoryFrame frame;
+    for (int f = 0; f < frames; f++) {
+        if (!reader.next(frame) || max_error(frame, recorded[f]) > DEFAULT_QUANTUM) return false;
+    }
+    return true;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::unique_ptr<TrajectorySink> open_sink(const std::string& backend, const std::string& path) {
+    if (backend == "uring") {
+        auto sink = open_uring_sink(path);
+        if (sink) return sink;
+        fprintf(stderr, "io_uring unavailable, falling back to fwrite\n");
+    }
+    return open_file_sink(path);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [num_boids] [steps] [keyframe_interval] [workers] [off|file|uring]\n",
+                argv[0]);
+        return 1;
+    }
+    const std::string path = argv[1];
+    int num_boids = argc > 2 ? atoi(argv[2]) : 20000;
+    int steps = argc > 3 ? atoi(argv[3]) : 200;
+    int keyframe_interval = argc > 4 ? atoi(argv[4]) : DEFAULT_KEYFRAME_INTERVAL;
+    unsigned int workers = argc > 5 ? static_cast<unsigned int>(atoi(argv[5])) : 2;
+    const std::string backend = argc > 6 ? argv[6] : "file";
+    bool recording = backend != "off";
+
+    BoidsWorld world;
+    world.populate(num_boids, 42);
+    BoidVector middle;
+    int middle_step = steps / 2;
+
+    std::unique_ptr<TrajectoryRecorder> recorder;
+    if (recording) {
+        recorder.reset(new TrajectoryRecorder(open_sink(backend, path), world.params(), keyframe_interval,
+                                              DEFAULT_QUANTUM, workers));
+        if (!recorder->ok()) {
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<double> step_times(steps);
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++) {
+        auto step_start = std::chrono::steady_clock::now();
+        world.step(1, RECORD_DT);
+        if (recorder) recorder->record(world.boids(), s);
+        step_times[s] = seconds_since(step_start);
+        if (s == middle_step) middle = world.boids();
+    }
+    double loop = seconds_since(start);
+    if (recorder) recorder->close();
+    double drained = seconds_since(start);
+
+    std::sort(step_times.begin(), step_times.end());
+    auto percentile = [&](double p) { return step_times[std::min<size_t>(steps - 1, p * steps)] * 1e3; };
+    printf("%d boids, %d steps, backend %s, keyframe every %d, %u workers\n", num_boids, steps, backend.c_str(),
+           keyframe_interval, workers);
+    printf("step loop %.3f ms/step, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", loop * 1e3 / steps, percentile(0.5),
+           percentile(0.99), step_times.back() * 1e3);
+    if (!recorder) return 0;
+
+    RecorderStats st = recorder->stats();
+    printf("record() %.3f ms/step on the simulation thread\n", st.capture_seconds * 1e3 / steps);
+    printf("raw %.2f MB, written %.2f MB, ratio %.1fx, %.2f bytes/boid/frame\n", st.raw_bytes / 1e6,
+           st.compressed_bytes / 1e6, static_cast<double>(st.raw_bytes) / st.compressed_bytes,
+           static_cast<double>(st.compressed_bytes) / (static_cast<double>(num_boids) * steps));
+    printf("sink writes took %.3f ms in total (%.1f MB/s), recorder drained %.3f ms after the last step\n",
+           st.write_seconds * 1e3, st.compressed_bytes / 1e6 / std::max(st.write_seconds, 1e-9),
+           (drained - loop) * 1e3);
+
+    // Full-precision snapshots through the same backend. One sink is
+    // reopened for every checkpoint, so a ring and its registered buffers
+    // are set up once per run rather than once per checkpoint.
+    auto setup_start = std::chrono::steady_clock::now();
+    auto sink = open_sink(backend, path + ".ckpt");
+    double setup_time = seconds_since(setup_start);
+    bool saved = static_cast<bool>(sink);
+    auto checkpoint_start = std::chrono::steady_clock::now();
+    for (int c = 0; c < RECORD_CHECKPOINTS && saved; c++) {
+        saved = (c == 0 || sink->reopen(path + ".ckpt")) && write_checkpoint(*sink, world.boids(), steps) &&
+                sink->close();
+    }
+    double checkpoint_time = seconds_since(checkpoint_start) / RECORD_CHECKPOINTS;
+    printf("checkpoint %s x%d: %.2f MB in %.3f ms each, %.1f MB/s (sink opened once in %.3f ms)\n",
+           saved ? "written" : "FAILED", RECORD_CHECKPOINTS, world.boids().size() * sizeof(Boid) / 1e6,
+           checkpoint_time * 1e3, world.boids().size() * sizeof(Boid) / 1e6 / checkpoint_time, setup_time * 1e3);
+
+    TrajectoryReader reader(path);
+    TrajectoryFrame frame;
+    if (!reader.ok() || reader.frames() != static_cast<uint64_t>(steps)) {
+        fprintf(stderr, "read back failed\n");
+        return 1;
+    }
+    float seek_error = reader.seek(middle_step) && reader.next(frame) ? max_error(frame, middle) : INFINITY;
+    float last_error = reader.seek(steps - 1) && reader.next(frame) ? max_error(frame, world.boids()) : INFINITY;
+    printf("read back: seek error %.5f, last frame error %.5f (quantum %.5f)\n", seek_error, last_error,
+           DEFAULT_QUANTUM);
+    bool groups = groups_round_trip(path + ".groups", world.boids(), world.params(), keyframe_interval);
+    printf("group changes between keyframes: %s\n", groups ? "read back" : "LOST");
+    return saved && groups && seek_error <= DEFAULT_QUANTUM && last_error <= DEFAULT_QUANTUM ? 0 : 1;
+}
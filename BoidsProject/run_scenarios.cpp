@@ -0,0 +1,114 @@
+// Headless runner for the scenario files in scenarios/, the standard
+// performance test bed for the update kernels.
+// Usage: BoidsScenario [-t threads] [-g grid_levels] [-p pic_cells] [-k max_neighbors]
+//                      [-s param=value]... [-f] [-c] <file.scn>...
+// -s overrides a BoidParams field in every scenario, after its own params
+// -k caps the neighbours sampled per boid on the grid kernels
+// -f smooths the particle-in-cell field with FFTs
+// -c keeps the positions as cells and offsets
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scenario.h"
+
+int main(int argc, char** argv) {
+    unsigned int threads = NUM_THREADS;
+    int grid_levels = -1; // -1 keeps what each scenario asks for
+    int pic_cells = -1;
+    int max_neighbors = -1;
+    std::vector<std::pair<std::string, float>> overrides;
+    bool pic_fft = false;
+    bool cell_positions = false;
+    int first = 1;
+    // Every argument starting with - must be a known flag with its value;
+    // anything else stops at the usage rather than being opened as a file
+    bool bad_flag = false;
+    while (first < argc && argv[first][0] == '-') {
+        const char* flag = argv[first];
+        if (strcmp(flag, "-f") == 0) {
+            pic_fft = true;
+            first++;
+            continue;
+        }
+        if (strcmp(flag, "-c") == 0) {
+            cell_positions = true;
+            first++;
+            continue;
+        }
+        const char* value = first + 1 < argc ? argv[first + 1] : nullptr;
+        const char* eq = value ? strchr(value, '=') : nullptr;
+        if (!value) bad_flag = true;
+        else if (strcmp(flag, "-t") == 0) threads = static_cast<unsigned int>(atoi(value));
+        else if (strcmp(flag, "-g") == 0) grid_levels = atoi(value);
+        else if (strcmp(flag, "-p") == 0) pic_cells = atoi(value);
+        else if (strcmp(flag, "-k") == 0) max_neighbors = atoi(value);
+        else if (strcmp(flag, "-s") == 0 && eq && eq != value) {
+            overrides.emplace_back(std::string(value, eq - value), static_cast<float>(atof(eq + 1)));
+        }
+        else bad_flag = true;
+        if (bad_flag) {
+            fprintf(stderr, "bad option %s%s%s\n", flag, value ? " " : "", value ? value : "");
+            break;
+        }
+        first += 2;
+    }
+    // Flags go before the files
+    for (int i = first; i < argc && !bad_flag; i++) {
+        if (argv[i][0] == '-') {
+            fprintf(stderr, "option %s after the scenario files\n", argv[i]);
+            bad_flag = true;
+        }
+    }
+    if (bad_flag || first >= argc) {
+        fprintf(stderr, "usage: %s [-t threads] [-g grid_levels] [-p pic_cells] [-k max_neighbors] [-s param=value]... [-f] [-c] <file.scn>...\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-20s %-9s %7s %6s %9s %9s %9s %9s %6s %6s  %s\n", "scenario", "engine", "boids", "steps", "total s", "p50 ms",
+           "p99 ms", "max ms", "polar", "mill", "state hash");
+    int failures = 0;
+    for (int i = first; i < argc; i++) {
+        Scenario scenario;
+        std::string error;
+        if (!load_scenario(argv[i], &scenario, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            failures++;
+            continue;
+        }
+        if (grid_levels >= 0) scenario.grid_levels = static_cast<unsigned int>(grid_levels);
+        if (pic_cells >= 0) scenario.pic_cells = pic_cells;
+        if (pic_fft) scenario.pic_fft = true;
+        if (cell_positions) scenario.cell_positions = true;
+        if (max_neighbors >= 0) scenario.params.max_neighbors = max_neighbors;
+        for (const auto& o : overrides) {
+            if (!set_param(scenario.params, o.first, o.second)) {
+                fprintf(stderr, "unknown param %s\n", o.first.c_str());
+                return 1;
+            }
+        }
+        std::string engine = scenario.pic_cells > 0 ? (scenario.pic_fft ? "fft" : "pic") + std::to_string(scenario.pic_cells)
+                           : scenario.grid_levels > 0 ? "grid" + std::to_string(scenario.grid_levels)
+                           : "direct";
+        // The cap runs on a grid even when the scenario asks for none
+        if (scenario.pic_cells == 0 && scenario.params.max_neighbors > 0) {
+            engine = (scenario.grid_levels > 0 ? engine : "grid1") + "/k" + std::to_string(scenario.params.max_neighbors);
+        }
+        if (scenario.pic_cells == 0 && scenario.params.accumulator == ACCUMULATE_DOUBLE) engine += "/f64";
+        if (scenario.pic_cells == 0 && scenario.params.accumulator == ACCUMULATE_KAHAN) engine += "/kahan";
+        if (scenario.pic_cells == 0 && scenario.cell_positions) {
+            engine = (engine == "direct" ? "grid1" : engine) + "/c";
+        }
+        ScenarioResult r = run_scenario(scenario, threads);
+        printf("%-20s %-9s %7d %6d %9.3f %9.3f %9.3f %9.3f %6.3f %6.3f  %016llx\n", scenario.name.c_str(),
+               engine.c_str(), r.final_boids, r.steps, r.total_seconds, r.p50_ms, r.p99_ms, r.max_ms,
+               r.polarization, r.milling, static_cast<unsigned long long>(r.hash));
+        fflush(stdout);
+    }
+    if (threads > 1) printf("hashes are only reproducible with -t 1\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,355 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "boids_world.h"
+#include "fft_convolution.h"
+
+namespace {
+
+struct ParamField {
+    const char* name;
+    float BoidParams::*field;
+};
+
+const ParamField PARAM_FIELDS[] = {
+    {"width", &BoidParams::width},
+    {"height", &BoidParams::height},
+    {"visual_range", &BoidParams::visual_range},
+    {"protected_range", &BoidParams::protected_range},
+    {"centering_factor", &BoidParams::centering_factor},
+    {"avoid_factor", &BoidParams::avoid_factor},
+    {"matching_factor", &BoidParams::matching_factor},
+    {"turn_factor", &BoidParams::turn_factor},
+    {"min_speed", &BoidParams::min_speed},
+    {"max_speed", &BoidParams::max_speed},
+    {"max_bias", &BoidParams::max_bias},
+    {"bias_increment", &BoidParams::bias_increment},
+    {"field_of_view", &BoidParams::field_of_view},
+    {"ttc_horizon", &BoidParams::ttc_horizon},
+    {"ttc_factor", &BoidParams::ttc_factor},
+    {"collision_radius", &BoidParams::collision_radius},
+};
+
+bool fail(std::string* error, const std::string& path, int line, const std::string& reason) {
+    if (error) *error = path + ":" + std::to_string(line) + ": " + reason;
+    return false;
+}
+
+// Steers boids away from the obstacles and pushes out any that got inside
+void avoid_obstacles(BoidVector& boids, const std::vector<ScenarioObstacle>& obstacles,
+                     const BoidParams& params) {
+    for (auto& b : boids) {
+        for (const auto& o : obstacles) {
+            float dx = b.x - o.x;
+            float dy = b.y - o.y;
+            float reach = o.radius + params.protected_range;
+            float dist_squared = dx*dx + dy*dy;
+            if (dist_squared >= reach*reach || dist_squared == 0.0f) continue;
+            float dist = std::sqrt(dist_squared);
+            b.vx += dx / dist * params.turn_factor;
+            b.vy += dy / dist * params.turn_factor;
+            if (dist < o.radius) {
+                b.x = o.x + dx / dist * o.radius;
+                b.y = o.y + dy / dist * o.radius;
+            }
+        }
+    }
+}
+
+void assign_groups(BoidVector& boids, int right_scouts, int left_scouts) {
+    for (size_t i = 0; i < boids.size(); i++) {
+        int k = static_cast<int>(i);
+        boids[i].scout_group = (k < right_scouts) ? 1 : (k < right_scouts + left_scouts) ? 2 : 0;
+    }
+}
+
+float* attribute_array(BoidAttributes& attrs, const std::string& name) {
+    if (name == "visual_range") return attrs.visual_range.data();
+    if (name == "min_speed") return attrs.min_speed.data();
+    if (name == "max_speed") return attrs.max_speed.data();
+    return nullptr;
+}
+
+void apply_event(BoidsWorld& world, const ScenarioEvent& event, uint64_t seed) {
+    switch (event.kind) {
+        case ScenarioEvent::Param: {
+            BoidParams params = world.params();
+            set_param(params, event.param, event.value);
+            world.set_params(params);
+            break;
+        }
+        case ScenarioEvent::Spawn: {
+            // Seeded from the scenario and the step so replays spawn the same boids
+            std::mt19937_64 rng(seed ^ (0x5bd1e995ull * (event.step + 1)));
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+            for (int k = 0; k < event.count; k++) {
+                float r = event.radius * std::sqrt(unit(rng));
+                float angle = TWO_PI * unit(rng);
+                world.spawn(event.x + r * std::cos(angle), event.y + r * std::sin(angle), speed(rng), speed(rng), 0);
+            }
+            break;
+        }
+        case ScenarioEvent::Despawn: {
+            const BoidVector& boids = world.boids();
+            // Backwards, so the boid swapped into a freed slot was already checked
+            for (int i = world.size() - 1; i >= 0; i--) {
+                float dx = boids[i].x - event.x;
+                float dy = boids[i].y - event.y;
+                if (dx*dx + dy*dy < event.radius*event.radius) world.remove(i);
+            }
+            break;
+        }
+    }
+}
+
+} // namespace
+
+bool set_param(BoidParams& params, const std::string& name, float value) {
+    if (name == "max_neighbors") {
+        params.max_neighbors = static_cast<int>(value);
+        return true;
+    }
+    if (name == "accumulator") {
+        params.accumulator = static_cast<int>(value);
+        return true;
+    }
+    for (const auto& p : PARAM_FIELDS) {
+        if (name == p.name) {
+            params.*p.field = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool load_scenario(const std::string& path, Scenario* scenario, std::string* error) {
+    std::ifstream in(path);
+    if (!in) return fail(error, path, 0, "cannot open");
+
+    Scenario s;
+    std::string text;
+    int line = 0;
+    while (std::getline(in, text)) {
+        line++;
+        size_t hash = text.find('#');
+        if (hash != std::string::npos) text.resize(hash);
+        std::istringstream words(text);
+        std::string key;
+        if (!(words >> key)) continue;
+
+        ScenarioEvent event;
+        bool timed = key == "at";
+        if (timed) {
+            if (!(words >> event.step >> key) || event.step < 0) return fail(error, path, line, "expected 'at <step> <event>'");
+        }
+
+        bool ok = true;
+        if (timed && key == "param") {
+            event.kind = ScenarioEvent::Param;
+            ok = static_cast<bool>(words >> event.param >> event.value);
+            BoidParams probe;
+            if (ok && !set_param(probe, event.param, event.value)) return fail(error, path, line, "unknown parameter " + event.param);
+        } else if (timed && key == "spawn") {
+            event.kind = ScenarioEvent::Spawn;
+            ok = static_cast<bool>(words >> event.count >> event.x >> event.y >> event.radius) && event.count >= 0;
+        } else if (timed && key == "despawn") {
+            event.kind = ScenarioEvent::Despawn;
+            ok = static_cast<bool>(words >> event.x >> event.y >> event.radius);
+        } else if (timed) {
+            return fail(error, path, line, "unknown event " + key);
+        } else if (key == "name") {
+            ok = static_cast<bool>(words >> s.name);
+        } else if (key == "world") {
+            ok = static_cast<bool>(words >> s.params.width >> s.params.height);
+        } else if (key == "boids") {
+            ok = static_cast<bool>(words >> s.boids) && s.boids >= 0;
+        } else if (key == "layout") {
+            std::string name;
+            ok = static_cast<bool>(words >> name) && parse_layout(name.c_str(), &s.layout);
+        } else if (key == "seed") {
+            ok = static_cast<bool>(words >> s.seed);
+        } else if (key == "groups") {
+            ok = static_cast<bool>(words >> s.right_scouts >> s.left_scouts);
+        } else if (key == "steps") {
+            ok = static_cast<bool>(words >> s.steps) && s.steps >= 0;
+        } else if (key == "dt") {
+            ok = static_cast<bool>(words >> s.dt);
+        } else if (key == "grid") {
+            ok = static_cast<bool>(words >> s.grid_levels);
+        } else if (key == "pic") {
+            ok = static_cast<bool>(words >> s.pic_cells) && s.pic_cells >= 0;
+            std::string smoother;
+            if (ok && words >> smoother) {
+                ok = smoother == "fft" || smoother == "direct";
+                s.pic_fft = smoother == "fft";
+            }
+        } else if (key == "positions") {
+            std::string kind;
+            ok = static_cast<bool>(words >> kind) && (kind == "float" || kind == "cells");
+            s.cell_positions = kind == "cells";
+        } else if (key == "param") {
+            std::string name;
+            float value;
+            ok = static_cast<bool>(words >> name >> value);
+            if (ok && !set_param(s.params, name, value)) return fail(error, path, line, "unknown parameter " + name);
+        } else if (key == "flow") {
+            ok = static_cast<bool>(words >> s.flow);
+            if (ok && !(words >> s.flow_strength)) s.flow_strength = FLOW_STRENGTH;
+            FlowPattern pattern;
+            if (ok && !parse_flow_pattern(s.flow.c_str(), &pattern) && !open_flow_file(s.flow))
+                return fail(error, path, line, "cannot open flow file " + s.flow);
+        } else if (key == "obstacle") {
+            ScenarioObstacle o;
+            ok = static_cast<bool>(words >> o.x >> o.y >> o.radius);
+            if (ok) s.obstacles.push_back(o);
+        } else if (key == "emitter") {
+            Emitter e;
+            ok = static_cast<bool>(words >> e.x >> e.y >> e.radius >> e.rate) && e.rate >= 0;
+            if (ok && words >> e.vx) ok = static_cast<bool>(words >> e.vy);
+            if (ok && !(words >> e.scout_group)) e.scout_group = 0;
+            if (ok) s.emitters.push_back(e);
+        } else if (key == "absorber") {
+            Absorber a;
+            ok = static_cast<bool>(words >> a.x >> a.y >> a.radius);
+            if (ok) s.absorbers.push_back(a);
+        } else if (key == "attractor") {
+            Attractor a;
+            ok = static_cast<bool>(words >> a.x >> a.y >> a.radius >> a.strength) && a.radius > 0;
+            if (ok) s.attractors.push_back(a);
+        } else if (key == "relay") {
+            RelayParams& r = s.relay_params;
+            ok = static_cast<bool>(words >> r.range >> r.delay) && r.range > 0 && r.delay >= 0;
+            if (ok && !(words >> r.memory)) r.memory = RELAY_MEMORY;
+            s.relay = ok;
+        } else if (key == "attribute") {
+            ScenarioAttribute a;
+            ok = static_cast<bool>(words >> a.group >> a.name >> a.value);
+            BoidAttributes probe;
+            probe.resize(1, s.params);
+            if (ok && !attribute_array(probe, a.name)) return fail(error, path, line, "unknown attribute " + a.name);
+            if (ok) s.attributes.push_back(a);
+        } else {
+            return fail(error, path, line, "unknown directive " + key);
+        }
+        if (!ok) return fail(error, path, line, "bad arguments to " + key);
+        if (timed) s.events.push_back(event);
+    }
+
+    std::stable_sort(s.events.begin(), s.events.end(),
+                     [](const ScenarioEvent& a, const ScenarioEvent& b) { return a.step < b.step; });
+    *scenario = s;
+    return true;
+}
+
+double polarization(const BoidVector& boids) {
+    double sx = 0.0, sy = 0.0;
+    for (const auto& b : boids) {
+        double speed = std::sqrt(double(b.vx) * b.vx + double(b.vy) * b.vy);
+        if (speed == 0.0) continue;
+        sx += b.vx / speed;
+        sy += b.vy / speed;
+    }
+    return boids.empty() ? 0.0 : std::sqrt(sx*sx + sy*sy) / boids.size();
+}
+
+double milling(const BoidVector& boids) {
+    if (boids.empty()) return 0.0;
+    double cx = 0.0, cy = 0.0;
+    for (const auto& b : boids) {
+        cx += b.x;
+        cy += b.y;
+    }
+    cx /= boids.size();
+    cy /= boids.size();
+    double spin = 0.0;
+    for (const auto& b : boids) {
+        double rx = b.x - cx, ry = b.y - cy;
+        double r = std::sqrt(rx*rx + ry*ry);
+        double speed = std::sqrt(double(b.vx) * b.vx + double(b.vy) * b.vy);
+        if (r == 0.0 || speed == 0.0) continue;
+        spin += (rx * b.vy - ry * b.vx) / (r * speed);
+    }
+    return std::abs(spin) / boids.size();
+}
+
+uint64_t state_hash(const BoidVector& boids) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(boids.data());
+    for (size_t i = 0; i < boids.size() * sizeof(Boid); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+ScenarioResult run_scenario(const Scenario& scenario, unsigned int num_threads) {
+    BoidsWorld world(scenario.params, num_threads);
+    world.set_grid_levels(scenario.grid_levels);
+    world.set_cell_positions(scenario.cell_positions);
+    if (scenario.pic_cells > 0 && scenario.pic_fft)
+        world.set_particle_in_cell(std::make_unique<FFTParticleInCell>(scenario.pic_cells));
+    else if (scenario.pic_cells > 0)
+        world.set_particle_in_cell(std::make_unique<ParticleInCell>(scenario.pic_cells));
+    world.populate(scenario.layout, scenario.boids, scenario.seed);
+    assign_groups(world.boids(), scenario.right_scouts, scenario.left_scouts);
+    if (!scenario.attributes.empty()) {
+        world.enable_attributes();
+        const BoidVector& boids = world.boids();
+        for (const auto& a : scenario.attributes) {
+            float* values = attribute_array(world.attributes(), a.name);
+            for (size_t i = 0; i < boids.size(); i++) {
+                if (boids[i].scout_group == a.group) values[i] = a.value;
+            }
+        }
+    }
+    if (!scenario.flow.empty()) {
+        FlowPattern pattern;
+        std::unique_ptr<FlowSource> source =
+            parse_flow_pattern(scenario.flow.c_str(), &pattern)
+                ? make_procedural_flow(pattern, scenario.params.width, scenario.params.height, scenario.seed)
+                : open_flow_file(scenario.flow);
+        if (source) world.set_flow_field(std::make_unique<FlowField>(std::move(source), scenario.flow_strength));
+    }
+    for (const auto& e : scenario.emitters) world.population().add_emitter(e);
+    for (const auto& a : scenario.absorbers) world.population().add_absorber(a);
+    world.attractors() = scenario.attractors;
+    if (scenario.relay) world.set_information(std::make_unique<InformationSpread>(scenario.relay_params));
+
+    std::vector<double> step_ms;
+    step_ms.reserve(scenario.steps);
+    size_t next_event = 0;
+    auto run_start = std::chrono::steady_clock::now();
+    for (int s = 0; s < scenario.steps; s++) {
+        auto step_start = std::chrono::steady_clock::now();
+        while (next_event < scenario.events.size() && scenario.events[next_event].step <= s) {
+            apply_event(world, scenario.events[next_event], scenario.seed);
+            next_event++;
+        }
+        world.step(1, scenario.dt);
+        if (!scenario.obstacles.empty()) avoid_obstacles(world.boids(), scenario.obstacles, world.params());
+        step_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - step_start).count());
+    }
+
+    ScenarioResult result;
+    result.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    result.steps = scenario.steps;
+    result.final_boids = world.size();
+    if (!step_ms.empty()) {
+        std::sort(step_ms.begin(), step_ms.end());
+        result.p50_ms = step_ms[step_ms.size() / 2];
+        result.p99_ms = step_ms[std::min(step_ms.size() - 1, step_ms.size() * 99 / 100)];
+        result.max_ms = step_ms.back();
+    }
+    result.polarization = polarization(world.boids());
+    result.milling = milling(world.boids());
+    result.hash = state_hash(world.boids());
+    return result;
+}
@@ -0,0 +1,124 @@
+//
+// Scenario files describing reproducible headless workloads, and the
+// runner that plays them back.
+//
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "attractors.h"
+#include "boids_parallel.h"
+#include "flow_field.h"
+#include "information.h"
+#include "initial_state.h"
+#include "population.h"
+
+// Line-based text format, one directive per line, '#' starts a comment:
+//
+//   name      <identifier>
+//   world     <width> <height>
+//   boids     <count>
+//   layout    <uniform|clusters|lattice|ring|flocks>
+//   seed      <integer>
+//   groups    <right scouts> <left scouts>
+//   steps     <count>
+//   dt        <seconds>
+//   grid      <levels>                         neighbour grid levels, 0 for brute force
+//   pic       <nodes per visual range> [fft]   particle-in-cell engine, 0 for off
+//   positions <float|cells>                    cells keeps them as cell and offset (cell_position.h)
+//   param     <name> <value>                   initial value of a BoidParams field
+//   flow      <vortices|shear|gusts|file> [<strength>]
+//                                              wind field, procedural or a flow file
+//   obstacle  <x> <y> <radius>
+//   emitter   <x> <y> <radius> <boids per second> [<vx> <vy> [<group>]]
+//   absorber  <x> <y> <radius>
+//   attractor <x> <y> <radius> <strength>      negative strength repels
+//   relay     <range> <delay> [<memory>]       scouts pass their bias on (information.h)
+//   attribute <group> <visual_range|min_speed|max_speed> <value>
+//                                              per-boid value for a scout group
+//   at <step> param <name> <value>             parameter schedule
+//   at <step> spawn <count> <x> <y> <radius>   boids appear in a disc
+//   at <step> despawn <x> <y> <radius>         boids in a disc are removed
+//
+// Events fire before the update of the step they name, in file order.
+// Flow file paths are relative to the working directory.
+
+struct ScenarioObstacle {
+    float x, y, radius;
+};
+
+struct ScenarioAttribute {
+    int group;
+    std::string name;
+    float value;
+};
+
+struct ScenarioEvent {
+    enum Kind { Param, Spawn, Despawn };
+    int step = 0;
+    Kind kind = Param;
+    std::string param;   // Param: field name
+    float value = 0.0f;  // Param: new value
+    int count = 0;       // Spawn: boids to add
+    float x = 0.0f, y = 0.0f, radius = 0.0f;
+};
+
+struct Scenario {
+    std::string name = "unnamed";
+    BoidParams params;
+    int boids = NUM_BOIDS;
+    InitialLayout layout = InitialLayout::Uniform;
+    uint64_t seed = 42;
+    int right_scouts = 10;
+    int left_scouts = 10;
+    int steps = 100;
+    float dt = 1.0f / 60.0f;
+    unsigned int grid_levels = 0;
+    int pic_cells = 0;
+    bool pic_fft = false;
+    bool cell_positions = false;
+    std::string flow; // empty for none, else a FlowPattern name or a flow file
+    float flow_strength = FLOW_STRENGTH;
+    std::vector<ScenarioObstacle> obstacles;
+    std::vector<Emitter> emitters;
+    std::vector<Absorber> absorbers;
+    std::vector<Attractor> attractors;
+    bool relay = false;
+    RelayParams relay_params;
+    std::vector<ScenarioAttribute> attributes; // any entry turns on per-boid attributes
+    std::vector<ScenarioEvent> events; // sorted by step, file order within a step
+};
+
+// Parses path into scenario; on failure error holds "file:line: reason"
+bool load_scenario(const std::string& path, Scenario* scenario, std::string* error);
+
+// Sets the BoidParams field called name, false if there is no such field
+bool set_param(BoidParams& params, const std::string& name, float value);
+
+// Alignment of the headings, 1 when all boids fly the same way
+double polarization(const BoidVector& boids);
+// Normalised angular momentum about the centre of mass, 1 for a perfect mill
+double milling(const BoidVector& boids);
+// FNV-1a over the raw state. With more than one thread the in-place update
+// lets a boid see neighbours that already moved this step, so the hash is
+// only reproducible across runs on a single thread.
+uint64_t state_hash(const BoidVector& boids);
+
+struct ScenarioResult {
+    int steps = 0;
+    int final_boids = 0;
+    double total_seconds = 0.0;
+    double p50_ms = 0.0, p99_ms = 0.0, max_ms = 0.0;
+    double polarization = 0.0;
+    double milling = 0.0;
+    uint64_t hash = 0;
+};
+
+// Plays the scenario headless on num_threads threads
+ScenarioResult run_scenario(const Scenario& scenario, unsigned int num_threads = NUM_THREADS);
+
+#endif //SCENARIO_H
@@ -0,0 +1,154 @@
+//
+// Hybrid spin-then-park barrier used to synchronise the worker pool.
+//
+
+#ifndef STEP_BARRIER_H
+#define STEP_BARRIER_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Pause instructions a waiter spins through before parking
+#define DEFAULT_SPIN_ITERS 4000
+// Threads sharing one counter of the combining tree
+#define BARRIER_FAN_IN 4
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Sense-reversing combining-tree barrier. Threads arrive in groups of
+// BARRIER_FAN_IN, so with 128 threads no counter is touched by more than
+// four cores; the last thread to reach the root flips the global sense.
+// Waiters spin on the sense for spin_iters pauses and then park on a futex.
+class StepBarrier {
+public:
+    explicit StepBarrier(unsigned int num_threads, unsigned int spin_iters = DEFAULT_SPIN_ITERS)
+        : num_threads_(num_threads ? num_threads : 1), spin_iters_(spin_iters),
+          local_sense_(new PaddedSense[num_threads_]) {
+        // Build the tree bottom-up: the first level holds one node per group of threads
+        unsigned int children = num_threads_;
+        int child_begin = -1; // first node of the level below, -1 while that level is the threads
+        do {
+            unsigned int first = static_cast<unsigned int>(expected_.size());
+            unsigned int parents = (children + BARRIER_FAN_IN - 1) / BARRIER_FAN_IN;
+            for (unsigned int p = 0; p < parents; p++) {
+                expected_.push_back(std::min<unsigned int>(BARRIER_FAN_IN, children - p * BARRIER_FAN_IN));
+                parent_.push_back(-1);
+            }
+            if (child_begin >= 0) {
+                for (unsigned int c = 0; c < children; c++)
+                    parent_[child_begin + c] = static_cast<int>(first + c / BARRIER_FAN_IN);
+            }
+            child_begin = static_cast<int>(first);
+            children = parents;
+        } while (children > 1);
+
+        nodes_.reset(new Node[expected_.size()]);
+        for (size_t i = 0; i < expected_.size(); i++)
+            nodes_[i].count.store(static_cast<int>(expected_[i]), std::memory_order_relaxed);
+        for (unsigned int t = 0; t < num_threads_; t++)
+            local_sense_[t].value = 0;
+    }
+
+    StepBarrier(const StepBarrier&) = delete;
+    StepBarrier& operator=(const StepBarrier&) = delete;
+
+    unsigned int size() const { return num_threads_; }
+
+    void set_spin_iters(unsigned int spin_iters) { spin_iters_ = spin_iters; }
+
+    // Blocks until all num_threads threads have called wait() with distinct ids
+    void wait(unsigned int thread_id) {
+        uint32_t my_sense = local_sense_[thread_id].value ^ 1u;
+        local_sense_[thread_id].value = my_sense;
+
+        int node = static_cast<int>(thread_id / BARRIER_FAN_IN);
+        while (true) {
+            if (nodes_[node].count.fetch_sub(1, std::memory_order_acq_rel) != 1) break;
+
+            // Last to arrive at this node: re-arm it and carry on to the parent
+            nodes_[node].count.store(static_cast<int>(expected_[node]), std::memory_order_relaxed);
+            if (parent_[node] < 0) {
+                release(my_sense);
+                return;
+            }
+            node = parent_[node];
+        }
+
+        for (unsigned int spin = 0; spin < spin_iters_; spin++) {
+            if (sense_.load(std::memory_order_acquire) == my_sense) return;
+            cpu_relax();
+        }
+        park(my_sense);
+    }
+
+private:
+    struct alignas(64) Node {
+        std::atomic<int> count{0};
+    };
+    struct alignas(64) PaddedSense {
+        uint32_t value;
+    };
+
+    void release(uint32_t new_sense) {
+        sense_.store(new_sense, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) == 0) return;
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sense_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        { std::lock_guard<std::mutex> lock(park_mutex_); }
+        park_cv_.notify_all();
+#endif
+    }
+
+    void park(uint32_t my_sense) {
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        while (sense_.load(std::memory_order_acquire) != my_sense) {
+#if defined(__linux__)
+            // Returns immediately if the sense already changed under us
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sense_), FUTEX_WAIT_PRIVATE, my_sense ^ 1u, nullptr, nullptr, 0);
+#else
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            park_cv_.wait(lock, [&] { return sense_.load(std::memory_order_acquire) == my_sense; });
+#endif
+        }
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    unsigned int num_threads_;
+    unsigned int spin_iters_;
+    std::unique_ptr<PaddedSense[]> local_sense_;
+    std::unique_ptr<Node[]> nodes_;
+    std::vector<unsigned int> expected_;
+    std::vector<int> parent_;
+
+    alignas(64) std::atomic<uint32_t> sense_{0};
+    alignas(64) std::atomic<int> sleepers_{0};
+#if !defined(__linux__)
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+#endif
+};
+
+#endif //STEP_BARRIER_H
@@ -0,0 +1,215 @@
+#include "stream_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Process-wide signal handling belongs to the host (C API, Python), so
+// SIGPIPE is suppressed per call, or per socket where MSG_NOSIGNAL is missing
+#ifdef MSG_NOSIGNAL
+#define STREAM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define STREAM_SEND_FLAGS 0
+#endif
+
+std::vector<uint8_t> encode_stream_frame(const BoidVector& boids, const BoidParams& params,
+                                         uint64_t sequence, uint64_t step) {
+    StreamFrameHeader header;
+    header.magic = STREAM_MAGIC;
+    header.version = STREAM_VERSION;
+    header.sequence = sequence;
+    header.step = step;
+    header.count = static_cast<uint32_t>(boids.size());
+    header.record_bytes = STREAM_RECORD_BYTES;
+    header.width = params.width;
+    header.height = params.height;
+
+    std::vector<uint8_t> frame(sizeof(header) + boids.size() * STREAM_RECORD_BYTES);
+    std::memcpy(frame.data(), &header, sizeof(header));
+
+    const float sx = 65535.0f / params.width, sy = 65535.0f / params.height;
+    uint8_t* out = frame.data() + sizeof(header);
+    for (const auto& b : boids) {
+        auto qx = static_cast<uint16_t>(clamp(b.x * sx, 0.0f, 65535.0f));
+        auto qy = static_cast<uint16_t>(clamp(b.y * sy, 0.0f, 65535.0f));
+        std::memcpy(out, &qx, 2);
+        std::memcpy(out + 2, &qy, 2);
+        out[4] = static_cast<uint8_t>(b.scout_group);
+        out += STREAM_RECORD_BYTES;
+    }
+    return frame;
+}
+
+static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+StreamServer::StreamServer(const std::string& socket_path) : socket_path_(socket_path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) return;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return;
+    unlink(socket_path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 16) < 0 || pipe(wake_pipe_) < 0) {
+        close(fd);
+        return;
+    }
+    set_nonblocking(fd);
+    set_nonblocking(wake_pipe_[0]);
+    set_nonblocking(wake_pipe_[1]);
+    listen_fd_ = fd;
+    sender_ = std::thread(&StreamServer::sender_loop, this);
+}
+
+StreamServer::~StreamServer() {
+    stop();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+    for (int fd : wake_pipe_) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void StreamServer::stop() {
+    if (!sender_.joinable()) return;
+    stop_.store(true);
+    char c = 0;
+    (void)!write(wake_pipe_[1], &c, 1);
+    sender_.join();
+}
+
+void StreamServer::publish(const BoidVector& boids, const BoidParams& params, uint64_t step) {
+    if (!ok()) return;
+    uint64_t sequence = head_.load(std::memory_order_relaxed) + 1;
+    Frame frame = std::make_shared<const std::vector<uint8_t>>(encode_stream_frame(boids, params, sequence, step));
+    {
+        std::lock_guard<std::mutex> lock(ring_mutex_);
+        ring_[sequence % STREAM_RING_FRAMES] = {sequence, std::move(frame)};
+        head_.store(sequence, std::memory_order_release);
+    }
+    // A full pipe already means the sender has a wake-up pending
+    char c = 1;
+    (void)!write(wake_pipe_[1], &c, 1);
+}
+
+// Takes the frame sub sends next, skipping those that left the ring. Head,
+// oldest and the slot are all read under the lock publish() writes them
+// under. False when sub is up to date.
+bool StreamServer::next_frame(Subscriber& sub) {
+    std::lock_guard<std::mutex> lock(ring_mutex_);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (sub.next_sequence > head) return false;
+    uint64_t oldest = head >= STREAM_RING_FRAMES ? head - STREAM_RING_FRAMES + 1 : 1;
+    // Too far behind, or the slot no longer holds the wanted frame: resync to the oldest kept
+    if (sub.next_sequence < oldest || ring_[sub.next_sequence % STREAM_RING_FRAMES].sequence != sub.next_sequence) {
+        if (oldest > sub.next_sequence) sub.stats.frames_dropped += oldest - sub.next_sequence;
+        sub.next_sequence = oldest;
+    }
+    const Slot& slot = ring_[sub.next_sequence % STREAM_RING_FRAMES];
+    if (slot.sequence != sub.next_sequence || !slot.frame) return false;
+    sub.frame = slot.frame;
+    sub.offset = 0;
+    return true;
+}
+
+// Writes as much as the socket takes; false once the subscriber is gone
+bool StreamServer::pump(Subscriber& sub) {
+    while (true) {
+        if (!sub.frame && !next_frame(sub)) return true;
+
+        const std::vector<uint8_t>& bytes = *sub.frame;
+        // A viewer that disconnects mid-write must not kill the process with SIGPIPE
+        ssize_t n = send(sub.fd, bytes.data() + sub.offset, bytes.size() - sub.offset, STREAM_SEND_FLAGS);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        sub.offset += static_cast<size_t>(n);
+        if (sub.offset < bytes.size()) return true;
+
+        sub.frame.reset();
+        sub.stats.frames_sent++;
+        sub.next_sequence++;
+    }
+}
+
+void StreamServer::sender_loop() {
+    std::vector<Subscriber> subs;
+    std::vector<pollfd> fds;
+
+    while (!stop_.load()) {
+        fds.clear();
+        fds.push_back({wake_pipe_[0], POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        uint64_t head = head_.load(std::memory_order_acquire);
+        for (const auto& sub : subs) {
+            bool pending = sub.frame || sub.next_sequence <= head;
+            fds.push_back({sub.fd, static_cast<short>(pending ? POLLOUT : POLLIN), 0});
+        }
+        if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_pipe_[0], drain, sizeof(drain)) > 0) {}
+        }
+        std::vector<short> revents(subs.size());
+        for (size_t i = 0; i < subs.size(); i++) revents[i] = fds[i + 2].revents;
+
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listen_fd_, nullptr, nullptr)) >= 0) {
+                set_nonblocking(fd);
+#ifdef SO_NOSIGPIPE
+                int on = 1;
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+                // New viewers start from the newest frame
+                subs.push_back({fd, nullptr, 0, std::max<uint64_t>(head_.load(), 1), {}});
+                revents.push_back(0);
+            }
+        }
+
+        for (size_t i = 0; i < subs.size();) {
+            bool alive = !(revents[i] & (POLLHUP | POLLERR));
+            if (alive && (revents[i] & POLLIN)) {
+                // Viewers have nothing to say; this only notices them leaving
+                char discard[256];
+                ssize_t n = recv(subs[i].fd, discard, sizeof(discard), 0);
+                alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+            }
+            if (alive) alive = pump(subs[i]);
+
+            if (!alive) {
+                close(subs[i].fd);
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                totals_.frames_sent += subs[i].stats.frames_sent;
+                totals_.frames_dropped += subs[i].stats.frames_dropped;
+                subs.erase(subs.begin() + i);
+                revents.erase(revents.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        num_subscribers_.store(static_cast<int>(subs.size()), std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    for (auto& sub : subs) {
+        totals_.frames_sent += sub.stats.frames_sent;
+        totals_.frames_dropped += sub.stats.frames_dropped;
+        close(sub.fd);
+    }
+}
+
+SubscriberStats StreamServer::totals() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return totals_;
+}
@@ -0,0 +1,106 @@
+//
+// Publishes compact state frames to any number of local viewers over a
+// Unix domain socket without ever blocking the simulation thread.
+//
+
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boids_parallel.h"
+
+// Frames kept for subscribers that fall behind; older ones are dropped
+#define STREAM_RING_FRAMES 8
+#define STREAM_MAGIC 0x44494f42u // "BOID"
+#define STREAM_VERSION 1
+
+// Every frame is this header followed by count records of
+// uint16 x, uint16 y (positions quantised over width x height) and uint8 group
+struct StreamFrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;
+    uint64_t step;
+    uint32_t count;
+    uint32_t record_bytes;
+    float width;
+    float height;
+};
+static_assert(sizeof(StreamFrameHeader) == 40, "frame header layout is part of the protocol");
+
+#define STREAM_RECORD_BYTES 5
+
+std::vector<uint8_t> encode_stream_frame(const BoidVector& boids, const BoidParams& params,
+                                         uint64_t sequence, uint64_t step);
+
+struct SubscriberStats {
+    uint64_t frames_sent = 0;
+    uint64_t frames_dropped = 0;
+};
+
+class StreamServer {
+public:
+    // Listens on socket_path, replacing a stale socket file left behind
+    explicit StreamServer(const std::string& socket_path);
+    ~StreamServer();
+
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+
+    bool ok() const { return listen_fd_ >= 0; }
+
+    // Encodes the state into the ring and wakes the sender; never waits on a subscriber
+    void publish(const BoidVector& boids, const BoidParams& params, uint64_t step);
+
+    // Closes every subscriber and stops the sender thread
+    void stop();
+
+    uint64_t frames_published() const { return head_.load(std::memory_order_relaxed); }
+    int subscribers() const { return num_subscribers_.load(std::memory_order_relaxed); }
+    // Totals over the subscribers that disconnected, or all of them after stop()
+    SubscriberStats totals() const;
+
+private:
+    using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Subscriber {
+        int fd;
+        Frame frame;       // frame being written, kept alive even if the ring moved on
+        size_t offset = 0;
+        uint64_t next_sequence;
+        SubscriberStats stats;
+    };
+
+    // A ring entry remembers its sequence, so a reader can tell it was overwritten
+    struct Slot {
+        uint64_t sequence = 0;
+        Frame frame;
+    };
+
+    void sender_loop();
+    bool next_frame(Subscriber& sub);
+    bool pump(Subscriber& sub);
+
+    std::string socket_path_;
+    int listen_fd_ = -1;
+    int wake_pipe_[2] = {-1, -1};
+
+    mutable std::mutex ring_mutex_;
+    Slot ring_[STREAM_RING_FRAMES];
+    std::atomic<uint64_t> head_{0}; // sequence of the newest frame, 0 before the first
+
+    std::atomic<bool> stop_{false};
+    std::atomic<int> num_subscribers_{0};
+    mutable std::mutex stats_mutex_;
+    SubscriberStats totals_;
+    std::thread sender_;
+};
+
+#endif //STREAM_SERVER_H
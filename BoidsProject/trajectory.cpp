@@ -0,0 +1,476 @@
+#include "trajectory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// ---- bit packing ------------------------------------------------------------
+
+// Each block of PACK_BLOCK values is stored with the bit width of its largest value
+static void pack_unsigned(const uint32_t* values, size_t n, std::vector<uint8_t>& out) {
+    for (size_t b = 0; b < n; b += PACK_BLOCK) {
+        size_t m = std::min<size_t>(PACK_BLOCK, n - b);
+        uint32_t all = 0;
+        for (size_t i = 0; i < m; i++) all |= values[b + i];
+        int width = all ? 32 - __builtin_clz(all) : 0;
+        out.push_back(static_cast<uint8_t>(width));
+
+        uint64_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < m; i++) {
+            acc |= static_cast<uint64_t>(values[b + i]) << bits;
+            bits += width;
+            while (bits >= 8) {
+                out.push_back(static_cast<uint8_t>(acc));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) out.push_back(static_cast<uint8_t>(acc));
+    }
+}
+
+static bool unpack_unsigned(const uint8_t*& p, const uint8_t* end, uint32_t* values, size_t n) {
+    for (size_t b = 0; b < n; b += PACK_BLOCK) {
+        size_t m = std::min<size_t>(PACK_BLOCK, n - b);
+        if (p >= end) return false;
+        int width = *p++;
+        if (width > 32 || static_cast<size_t>(end - p) < (m * width + 7) / 8) return false;
+
+        const uint64_t mask = (uint64_t(1) << width) - 1;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < m; i++) {
+            while (bits < width) {
+                acc |= static_cast<uint64_t>(*p++) << bits;
+                bits += 8;
+            }
+            values[b + i] = static_cast<uint32_t>(acc & mask);
+            acc >>= width;
+            bits -= width;
+        }
+    }
+    return true;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t z) {
+    return static_cast<int32_t>((z >> 1) ^ (0u - (z & 1u)));
+}
+
+static uint32_t spread_bits(uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// ---- file sink --------------------------------------------------------------
+
+class FileSink : public TrajectorySink {
+public:
+    explicit FileSink(FILE* file) : file_(file) {}
+    ~FileSink() override { close(); }
+
+    bool write(const void* data, size_t bytes) override {
+        return file_ && fwrite(data, 1, bytes, file_) == bytes;
+    }
+
+    bool close() override {
+        if (!file_) return true;
+        bool ok = fclose(file_) == 0;
+        file_ = nullptr;
+        return ok;
+    }
+
+    bool reopen(const std::string& path) override {
+        bool ok = close();
+        file_ = fopen(path.c_str(), "wb");
+        return ok && file_;
+    }
+
+private:
+    FILE* file_;
+};
+
+std::unique_ptr<TrajectorySink> open_file_sink(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return nullptr;
+    return std::unique_ptr<TrajectorySink>(new FileSink(file));
+}
+
+// ---- recorder ---------------------------------------------------------------
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string& path, const BoidParams& params, int keyframe_interval,
+                                       float quantum, unsigned int workers, size_t max_pending)
+    : TrajectoryRecorder(open_file_sink(path), params, keyframe_interval, quantum, workers, max_pending) {}
+
+TrajectoryRecorder::TrajectoryRecorder(std::unique_ptr<TrajectorySink> sink, const BoidParams& params,
+                                       int keyframe_interval, float quantum, unsigned int workers,
+                                       size_t max_pending)
+    : sink_(std::move(sink)), keyframe_interval_(std::max(1, keyframe_interval)), quantum_(quantum),
+      max_pending_(std::max<size_t>(1, max_pending)) {
+    if (sink_) start(params, workers);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+}
+
+void TrajectoryRecorder::start(const BoidParams& params, unsigned int workers) {
+    width_ = params.width;
+    height_ = params.height;
+
+    TrajectoryFileHeader header;
+    header.magic = TRAJECTORY_MAGIC;
+    header.version = TRAJECTORY_VERSION;
+    header.width = params.width;
+    header.height = params.height;
+    header.quantum = quantum_;
+    header.keyframe_interval = static_cast<uint32_t>(keyframe_interval_);
+    failed_ = !sink_->write(&header, sizeof(header));
+    written_bytes_ = sizeof(header);
+
+    for (unsigned int i = 0; i < std::max(1u, workers); i++) {
+        workers_.emplace_back(&TrajectoryRecorder::worker_loop, this);
+    }
+    writer_ = std::thread(&TrajectoryRecorder::writer_loop, this);
+}
+
+void TrajectoryRecorder::record(const BoidVector& boids, uint64_t step) {
+    if (!sink_ || closed_) return;
+    auto start = std::chrono::steady_clock::now();
+
+    size_t n = boids.size();
+    auto qx = std::make_shared<std::vector<int32_t>>(n);
+    auto qy = std::make_shared<std::vector<int32_t>>(n);
+    auto new_groups = std::make_shared<std::vector<uint8_t>>(n);
+    const float inv = 1.0f / quantum_;
+    for (size_t i = 0; i < n; i++) {
+        (*qx)[i] = static_cast<int32_t>(std::lround(boids[i].x * inv));
+        (*qy)[i] = static_cast<int32_t>(std::lround(boids[i].y * inv));
+        (*new_groups)[i] = static_cast<uint8_t>(boids[i].scout_group);
+    }
+    // Unchanged groups share the last frame's copy, so the encoder has nothing to compare
+    Groups groups = new_groups;
+    if (last_groups_ && *last_groups_ == *new_groups) groups = last_groups_;
+
+    Job job;
+    job.index = next_index_++;
+    job.step = step;
+    job.qx = qx;
+    job.qy = qy;
+    // A change in population breaks the delta chain, so it starts a keyframe
+    job.keyframe = job.index % keyframe_interval_ == 0 || !last_qx_ || last_qx_->size() != n;
+    job.groups = groups;
+    if (job.keyframe) {
+        job.order_out = std::make_shared<std::promise<Order>>();
+        last_order_ = job.order_out->get_future().share();
+    } else {
+        job.prev_qx = last_qx_;
+        job.prev_qy = last_qy_;
+        job.prev_groups = last_groups_;
+    }
+    job.order = last_order_;
+    last_qx_ = qx;
+    last_qy_ = qy;
+    last_groups_ = groups;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [&] { return pending_ < max_pending_; });
+        queue_.push_back(std::move(job));
+        pending_++;
+        stats_.frames++;
+        stats_.raw_bytes += n * 4 * sizeof(float);
+        stats_.capture_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    work_cv_.notify_one();
+}
+
+std::vector<uint8_t> TrajectoryRecorder::compress(const Job& job) {
+    size_t n = job.qx->size();
+    std::vector<uint8_t> out(sizeof(TrajectoryFrameHeader));
+    out.reserve(sizeof(TrajectoryFrameHeader) + n * 3);
+    std::vector<uint32_t> values(n);
+
+    Order order;
+    if (job.keyframe) {
+        // Morton order keeps boids that are close in space close in the streams
+        std::vector<std::pair<uint32_t, uint32_t>> keys(n);
+        const float sx = 65535.0f / width_, sy = 65535.0f / height_;
+        for (size_t i = 0; i < n; i++) {
+            float wx = clamp((*job.qx)[i] * quantum_ * sx, 0.0f, 65535.0f);
+            float wy = clamp((*job.qy)[i] * quantum_ * sy, 0.0f, 65535.0f);
+            keys[i] = {spread_bits(static_cast<uint32_t>(wx)) | (spread_bits(static_cast<uint32_t>(wy)) << 1),
+                       static_cast<uint32_t>(i)};
+        }
+        std::sort(keys.begin(), keys.end());
+        auto sorted = std::make_shared<std::vector<uint32_t>>(n);
+        for (size_t k = 0; k < n; k++) (*sorted)[k] = keys[k].second;
+        order = sorted;
+        job.order_out->set_value(order);
+
+        pack_unsigned(order->data(), n, out);
+        for (size_t k = 0; k < n; k++) values[k] = (*job.groups)[(*order)[k]];
+        pack_unsigned(values.data(), n, out);
+
+        // Positions as deltas between neighbours along the curve
+        const std::vector<int32_t>* axes[2] = {job.qx.get(), job.qy.get()};
+        for (auto* q : axes) {
+            int32_t prev = 0;
+            for (size_t k = 0; k < n; k++) {
+                int32_t v = (*q)[(*order)[k]];
+                values[k] = zigzag(v - prev);
+                prev = v;
+            }
+            pack_unsigned(values.data(), n, out);
+        }
+    } else {
+        order = job.order.get();
+        const std::vector<int32_t>* axes[2][2] = {{job.qx.get(), job.prev_qx.get()}, {job.qy.get(), job.prev_qy.get()}};
+        for (auto& axis : axes) {
+            for (size_t k = 0; k < n; k++) {
+                uint32_t i = (*order)[k];
+                values[k] = zigzag((*axis[0])[i] - (*axis[1])[i]);
+            }
+            pack_unsigned(values.data(), n, out);
+        }
+
+        // Groups that changed since the previous frame: their count, then
+        // the gaps between their places in the order, then the new groups
+        std::vector<uint32_t> gaps, changed;
+        if (job.groups != job.prev_groups) {
+            size_t last = 0;
+            for (size_t k = 0; k < n; k++) {
+                uint32_t i = (*order)[k];
+                if ((*job.groups)[i] == (*job.prev_groups)[i]) continue;
+                gaps.push_back(static_cast<uint32_t>(k - last));
+                changed.push_back((*job.groups)[i]);
+                last = k;
+            }
+        }
+        uint32_t count = static_cast<uint32_t>(gaps.size());
+        pack_unsigned(&count, 1, out);
+        pack_unsigned(gaps.data(), count, out);
+        pack_unsigned(changed.data(), count, out);
+    }
+
+    TrajectoryFrameHeader header;
+    header.magic = TRAJECTORY_FRAME_MAGIC;
+    header.keyframe = job.keyframe ? 1 : 0;
+    header.step = job.step;
+    header.count = static_cast<uint32_t>(n);
+    header.payload_bytes = static_cast<uint32_t>(out.size() - sizeof(header));
+    std::memcpy(out.data(), &header, sizeof(header));
+    return out;
+}
+
+void TrajectoryRecorder::worker_loop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        std::vector<uint8_t> bytes = compress(job);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_[job.index] = std::move(bytes);
+        }
+        done_cv_.notify_one();
+    }
+}
+
+// Frames finish out of order on the workers but reach the sink in sequence
+void TrajectoryRecorder::writer_loop() {
+    uint64_t next = 0;
+    while (true) {
+        std::vector<uint8_t> bytes;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_cv_.wait(lock, [&] { return done_.count(next) || (stopping_ && pending_ == 0); });
+            auto it = done_.find(next);
+            if (it == done_.end()) return;
+            bytes = std::move(it->second);
+            done_.erase(it);
+        }
+
+        TrajectoryFrameHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        auto write_start = std::chrono::steady_clock::now();
+        bool ok = sink_->write(bytes.data(), bytes.size());
+        double write_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.write_seconds += write_time;
+            if (header.keyframe) keyframes_.push_back({next, written_bytes_});
+            written_bytes_ += bytes.size();
+            frames_written_++;
+            failed_ |= !ok;
+            pending_--;
+        }
+        space_cv_.notify_all();
+        done_cv_.notify_all();
+        next++;
+    }
+}
+
+void TrajectoryRecorder::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = stats_.frames;
+    space_cv_.wait(lock, [&] { return frames_written_ >= target || stopping_; });
+}
+
+void TrajectoryRecorder::close() {
+    if (!sink_ || closed_) return;
+    closed_ = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    done_cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    writer_.join();
+
+    TrajectoryTrailer trailer;
+    trailer.index_offset = written_bytes_;
+    trailer.frames = stats_.frames;
+    trailer.keyframes = static_cast<uint32_t>(keyframes_.size());
+    trailer.magic = TRAJECTORY_INDEX_MAGIC;
+    bool ok = keyframes_.empty() || sink_->write(keyframes_.data(), keyframes_.size() * sizeof(TrajectoryKeyframe));
+    ok = ok && sink_->write(&trailer, sizeof(trailer));
+    written_bytes_ += keyframes_.size() * sizeof(TrajectoryKeyframe) + sizeof(trailer);
+    failed_ |= !ok || !sink_->close();
+}
+
+RecorderStats TrajectoryRecorder::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecorderStats s = stats_;
+    s.compressed_bytes = written_bytes_;
+    return s;
+}
+
+// ---- reader -----------------------------------------------------------------
+
+TrajectoryReader::TrajectoryReader(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return;
+
+    TrajectoryTrailer trailer;
+    bool ok = fread(&header_, sizeof(header_), 1, file) == 1 && header_.magic == TRAJECTORY_MAGIC &&
+              header_.version >= 1 && header_.version <= TRAJECTORY_VERSION &&
+              fseek(file, -static_cast<long>(sizeof(trailer)), SEEK_END) == 0 &&
+              fread(&trailer, sizeof(trailer), 1, file) == 1 && trailer.magic == TRAJECTORY_INDEX_MAGIC;
+    if (ok) {
+        keyframes_.resize(trailer.keyframes);
+        ok = fseek(file, static_cast<long>(trailer.index_offset), SEEK_SET) == 0 &&
+             (keyframes_.empty() || fread(keyframes_.data(), sizeof(TrajectoryKeyframe), keyframes_.size(), file) ==
+                                        keyframes_.size()) &&
+             fseek(file, sizeof(header_), SEEK_SET) == 0;
+    }
+    if (!ok) {
+        fclose(file);
+        return;
+    }
+    file_ = file;
+    frames_ = trailer.frames;
+    data_end_ = trailer.index_offset;
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    if (file_) fclose(file_);
+}
+
+bool TrajectoryReader::seek(uint64_t frame) {
+    if (!file_ || frame >= frames_ || keyframes_.empty()) return false;
+    // Latest keyframe at or before the target, then decode forward from it
+    auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), frame,
+                               [](uint64_t f, const TrajectoryKeyframe& k) { return f < k.frame; });
+    if (it == keyframes_.begin()) return false;
+    --it;
+    if (fseek(file_, static_cast<long>(it->offset), SEEK_SET) != 0) return false;
+    current_ = it->frame;
+    while (current_ < frame) {
+        if (!read_frame(nullptr)) return false;
+    }
+    return true;
+}
+
+bool TrajectoryReader::next(TrajectoryFrame& out) {
+    return file_ && current_ < frames_ && read_frame(&out);
+}
+
+bool TrajectoryReader::read_frame(TrajectoryFrame* out) {
+    TrajectoryFrameHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1 || header.magic != TRAJECTORY_FRAME_MAGIC) return false;
+    payload_.resize(header.payload_bytes);
+    if (!payload_.empty() && fread(payload_.data(), 1, payload_.size(), file_) != payload_.size()) return false;
+
+    size_t n = header.count;
+    const uint8_t* p = payload_.data();
+    const uint8_t* end = p + payload_.size();
+    std::vector<uint32_t> values(n);
+
+    if (header.keyframe) {
+        order_.resize(n);
+        groups_.resize(n);
+        qx_.resize(n);
+        qy_.resize(n);
+        if (!unpack_unsigned(p, end, order_.data(), n) || !unpack_unsigned(p, end, values.data(), n)) return false;
+        for (size_t k = 0; k < n; k++) groups_[k] = static_cast<uint8_t>(values[k]);
+        for (auto* q : {&qx_, &qy_}) {
+            if (!unpack_unsigned(p, end, values.data(), n)) return false;
+            int32_t prev = 0;
+            for (size_t k = 0; k < n; k++) {
+                prev += unzigzag(values[k]);
+                (*q)[k] = prev;
+            }
+        }
+    } else {
+        if (qx_.size() != n) return false;
+        for (auto* q : {&qx_, &qy_}) {
+            if (!unpack_unsigned(p, end, values.data(), n)) return false;
+            for (size_t k = 0; k < n; k++) (*q)[k] += unzigzag(values[k]);
+        }
+        if (header_.version >= 2) {
+            uint32_t count;
+            if (!unpack_unsigned(p, end, &count, 1) || count > n) return false;
+            std::vector<uint32_t> gaps(count), changed(count);
+            if (!unpack_unsigned(p, end, gaps.data(), count) || !unpack_unsigned(p, end, changed.data(), count))
+                return false;
+            size_t k = 0;
+            for (uint32_t c = 0; c < count; c++) {
+                k += gaps[c];
+                if (k >= n) return false;
+                groups_[k] = static_cast<uint8_t>(changed[c]);
+            }
+        }
+    }
+    current_++;
+
+    if (out) {
+        out->step = header.step;
+        out->x.resize(n);
+        out->y.resize(n);
+        out->scout_group.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            uint32_t i = order_[k];
+            if (i >= n) return false;
+            out->x[i] = qx_[k] * header_.quantum;
+            out->y[i] = qy_[k] * header_.quantum;
+            out->scout_group[i] = groups_[k];
+        }
+    }
+    return true;
+}
@@ -0,0 +1,204 @@
+//
+// Compressed trajectory recording: quantised positions, delta-encoded
+// against the previous frame in Morton order and bit-packed, with periodic
+// keyframes for seeking. Compression runs on background threads.
+//
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boids_parallel.h"
+
+#define TRAJECTORY_MAGIC 0x4a525442u  // "BTRJ"
+// 2: delta frames also carry the scout groups that changed; 1 is still read
+#define TRAJECTORY_VERSION 2
+#define TRAJECTORY_FRAME_MAGIC 0x4d415246u // "FRAM"
+#define TRAJECTORY_INDEX_MAGIC 0x58444e49u // "INDX"
+
+#define DEFAULT_KEYFRAME_INTERVAL 32
+#define DEFAULT_QUANTUM (1.0f / 64.0f) // world units per quantisation step
+// Values sharing one bit width in the packed streams
+#define PACK_BLOCK 64
+
+struct TrajectoryFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    float width;
+    float height;
+    float quantum;
+    uint32_t keyframe_interval;
+};
+
+struct TrajectoryFrameHeader {
+    uint32_t magic;
+    uint32_t keyframe;
+    uint64_t step;
+    uint32_t count;
+    uint32_t payload_bytes;
+};
+
+// Appended after the last frame: keyframe offsets, then this trailer
+struct TrajectoryTrailer {
+    uint64_t index_offset;
+    uint64_t frames;
+    uint32_t keyframes;
+    uint32_t magic;
+};
+
+struct TrajectoryKeyframe {
+    uint64_t frame;
+    uint64_t offset;
+};
+
+// A decoded frame, boids in the order they had in the simulation
+struct TrajectoryFrame {
+    uint64_t step = 0;
+    std::vector<float> x, y;
+    std::vector<uint8_t> scout_group;
+};
+
+struct RecorderStats {
+    uint64_t frames = 0;
+    uint64_t raw_bytes = 0;        // what x, y, vx, vy as floats would have taken
+    uint64_t compressed_bytes = 0;
+    double capture_seconds = 0.0;  // time spent inside record(), on the caller's thread
+    double write_seconds = 0.0;    // time the writer thread spent handing bytes to the sink
+};
+
+// Where the recorder's bytes go; the default appends to a file with fwrite.
+// The recorder hands over the file header and then every frame in a single
+// write() call each, so a sink can also keep frames apart in memory.
+class TrajectorySink {
+public:
+    virtual ~TrajectorySink() = default;
+    virtual bool write(const void* data, size_t bytes) = 0;
+    virtual bool close() = 0;
+    // Closes the current file and starts writing path, keeping whatever the
+    // sink set up once (rings, registered buffers). False if it cannot.
+    virtual bool reopen(const std::string&) { return false; }
+};
+
+std::unique_ptr<TrajectorySink> open_file_sink(const std::string& path);
+
+class TrajectoryRecorder {
+public:
+    TrajectoryRecorder(const std::string& path, const BoidParams& params,
+                       int keyframe_interval = DEFAULT_KEYFRAME_INTERVAL, float quantum = DEFAULT_QUANTUM,
+                       unsigned int workers = 2, size_t max_pending = 8);
+    TrajectoryRecorder(std::unique_ptr<TrajectorySink> sink, const BoidParams& params,
+                       int keyframe_interval = DEFAULT_KEYFRAME_INTERVAL, float quantum = DEFAULT_QUANTUM,
+                       unsigned int workers = 2, size_t max_pending = 8);
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    bool ok() const { return sink_ != nullptr && !failed_; }
+
+    // Quantises the positions and queues the frame; only waits if more than
+    // max_pending frames are still being compressed or written
+    void record(const BoidVector& boids, uint64_t step);
+
+    // Waits until every frame recorded so far has reached the sink
+    void flush();
+
+    // Drains the queue and writes the keyframe index
+    void close();
+
+    RecorderStats stats() const;
+
+private:
+    using Positions = std::shared_ptr<const std::vector<int32_t>>;
+    using Order = std::shared_ptr<const std::vector<uint32_t>>;
+    using Groups = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Job {
+        uint64_t index;
+        bool keyframe;
+        uint64_t step;
+        Positions qx, qy, prev_qx, prev_qy;
+        Groups groups, prev_groups;
+        std::shared_ptr<std::promise<Order>> order_out; // set by keyframes
+        std::shared_future<Order> order;                // Morton order of the last keyframe
+    };
+
+    void start(const BoidParams& params, unsigned int workers);
+    void worker_loop();
+    void writer_loop();
+    std::vector<uint8_t> compress(const Job& job);
+
+    std::unique_ptr<TrajectorySink> sink_;
+    int keyframe_interval_;
+    float quantum_;
+    float width_ = WIDTH, height_ = HEIGHT;
+    size_t max_pending_;
+    bool failed_ = false;
+    bool closed_ = false;
+
+    // Producer-side state, only touched by record()
+    uint64_t next_index_ = 0;
+    Positions last_qx_, last_qy_;
+    Groups last_groups_;
+    std::shared_future<Order> last_order_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_, done_cv_, space_cv_;
+    std::deque<Job> queue_;
+    std::map<uint64_t, std::vector<uint8_t>> done_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+    uint64_t written_bytes_ = 0;
+    uint64_t frames_written_ = 0;
+    std::vector<TrajectoryKeyframe> keyframes_;
+    RecorderStats stats_;
+
+    std::vector<std::thread> workers_;
+    std::thread writer_;
+};
+
+class TrajectoryReader {
+public:
+    explicit TrajectoryReader(const std::string& path);
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    bool ok() const { return file_ != nullptr; }
+    uint64_t frames() const { return frames_; }
+    const TrajectoryFileHeader& header() const { return header_; }
+
+    // Positions the reader so that the next call to next() returns frame
+    bool seek(uint64_t frame);
+    bool next(TrajectoryFrame& out);
+
+private:
+    bool read_frame(TrajectoryFrame* out);
+
+    FILE* file_ = nullptr;
+    TrajectoryFileHeader header_{};
+    uint64_t frames_ = 0;
+    uint64_t data_end_ = 0;
+    uint64_t current_ = 0;
+    std::vector<TrajectoryKeyframe> keyframes_;
+
+    // Decoder state, positions in the Morton order of the last keyframe
+    std::vector<uint32_t> order_;
+    std::vector<int32_t> qx_, qy_;
+    std::vector<uint8_t> groups_;
+    std::vector<uint8_t> payload_;
+};
+
+#endif //TRAJECTORY_H
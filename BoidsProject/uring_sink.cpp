@@ -0,0 +1,346 @@
+#include "uring_sink.h"
+
+#if defined(__linux__) && defined(BOIDS_HAVE_IO_URING)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define URING_ENTRIES 64
+#define URING_STOP_TAG ~0ull
+
+static int uring_setup(unsigned int entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int uring_register(int fd, unsigned int opcode, const void* arg, unsigned int nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// The ring indices are shared with the kernel
+static unsigned int load_acquire(const unsigned int* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void store_release(unsigned int* p, unsigned int v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+class UringSink : public TrajectorySink {
+public:
+    ~UringSink() override {
+        close();
+        stop();
+        teardown();
+    }
+
+    bool init(const std::string& path) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd_ = uring_setup(URING_ENTRIES, &params);
+        if (ring_fd_ < 0) return false;
+
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+        sq_ring_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) return false;
+        cq_ring_ = single ? sq_ring_
+                          : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                 IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) return false;
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) return false;
+
+        auto* sq = static_cast<char*>(sq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Pin the staging buffers once so the kernel skips the per-write mapping
+        iovec iov[URING_BUFFERS];
+        for (int i = 0; i < URING_BUFFERS; i++) {
+            void* mem = nullptr;
+            if (posix_memalign(&mem, 4096, URING_BUFFER_BYTES) != 0) return false;
+            buffers_[i].data = static_cast<uint8_t*>(mem);
+            iov[i] = {mem, URING_BUFFER_BYTES};
+            free_.push_back(i);
+        }
+        if (uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iov, URING_BUFFERS) < 0) return false;
+
+        completer_ = std::thread(&UringSink::completion_loop, this);
+        return open_file(path);
+    }
+
+    bool write(const void* data, size_t bytes) override {
+        if (file_fd_ < 0) return false;
+        auto* src = static_cast<const uint8_t*>(data);
+        while (bytes > 0) {
+            if (current_ < 0 && (current_ = acquire()) < 0) return false;
+            Buffer& buf = buffers_[current_];
+            size_t n = std::min(bytes, static_cast<size_t>(URING_BUFFER_BYTES) - buf.used);
+            std::memcpy(buf.data + buf.used, src, n);
+            buf.used += n;
+            src += n;
+            bytes -= n;
+            if (buf.used == URING_BUFFER_BYTES) seal();
+        }
+        return !failed_.load();
+    }
+
+    // Waits for the file's writes and closes it; the ring, the registered
+    // buffers and the completion thread stay for the next reopen()
+    bool close() override {
+        if (file_fd_ < 0) return !failed_.load();
+        if (current_ >= 0 && buffers_[current_].used > 0) seal();
+        {
+            std::lock_guard<std::mutex> lock(sq_mutex_);
+            flush_locked();
+        }
+        {
+            std::unique_lock<std::mutex> lock(free_mutex_);
+            free_cv_.wait(lock, [&] { return in_flight_ == 0 || completer_done_; });
+        }
+        if (::close(file_fd_) != 0) failed_.store(true);
+        file_fd_ = -1;
+        return !failed_.load();
+    }
+
+    bool reopen(const std::string& path) override {
+        bool ok = close();
+        return open_file(path) && ok;
+    }
+
+private:
+    struct Buffer {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+    };
+
+    bool open_file(const std::string& path) {
+        // A ring that failed stays failed; its buffers may still be in flight
+        if (failed_.load()) return false;
+        file_fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        file_offset_ = 0;
+        return file_fd_ >= 0;
+    }
+
+    // -1 once the completion thread is gone and no buffer will come back
+    int acquire() {
+        std::unique_lock<std::mutex> lock(free_mutex_);
+        if (free_.empty()) {
+            // Everything is queued: make sure it reached the kernel before waiting on it
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> sq_lock(sq_mutex_);
+                flush_locked();
+            }
+            lock.lock();
+            free_cv_.wait(lock, [&] { return !free_.empty() || completer_done_; });
+            if (free_.empty()) return -1;
+        }
+        int index = free_.back();
+        free_.pop_back();
+        buffers_[index].used = 0;
+        return index;
+    }
+
+    void seal() {
+        int index = current_;
+        current_ = -1;
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            in_flight_++;
+        }
+        std::lock_guard<std::mutex> lock(sq_mutex_);
+        queue_write_locked(index, 0, file_offset_);
+        file_offset_ += buffers_[index].used;
+        if (unsubmitted_ >= URING_SUBMIT_BATCH) flush_locked();
+    }
+
+    io_uring_sqe* next_sqe_locked() {
+        unsigned int tail = *sq_tail_;
+        unsigned int slot = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[slot] = slot;
+        store_release(sq_tail_, tail + 1);
+        unsubmitted_++;
+        return sqe;
+    }
+
+    // Writes buffers_[index] from byte skip onwards at file offset + skip
+    void queue_write_locked(int index, size_t skip, uint64_t offset) {
+        io_uring_sqe* sqe = next_sqe_locked();
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = file_fd_;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers_[index].data + skip);
+        sqe->len = static_cast<uint32_t>(buffers_[index].used - skip);
+        sqe->off = offset + skip;
+        sqe->buf_index = static_cast<uint16_t>(index);
+        sqe->user_data = (static_cast<uint64_t>(index) << 32) | skip;
+        offsets_[index] = offset;
+    }
+
+    void flush_locked() {
+        while (unsubmitted_ > 0) {
+            int n = uring_enter(ring_fd_, unsubmitted_, 0, 0);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                failed_.store(true);
+                return;
+            }
+            unsubmitted_ -= static_cast<unsigned int>(n);
+        }
+    }
+
+    void completion_loop() {
+        bool stop = false;
+        while (!stop) {
+            if (uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+                if (errno == EAGAIN || errno == EBUSY) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                } else if (errno != EINTR) {
+                    // Waiting again would fail the same way: give up and release the writers
+                    failed_.store(true);
+                    break;
+                }
+            }
+            unsigned int head = *cq_head_;
+            unsigned int tail = load_acquire(cq_tail_);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data == URING_STOP_TAG) {
+                    stop = true;
+                    continue;
+                }
+                // A failed write ends the loop once this batch is drained
+                if (!complete(static_cast<int>(cqe.user_data >> 32), cqe.user_data & 0xffffffffu, cqe.res))
+                    stop = true;
+            }
+            store_release(cq_head_, head);
+        }
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            completer_done_ = true;
+        }
+        free_cv_.notify_all();
+    }
+
+    // A no-op wakes the completion thread out of its blocking wait
+    void stop() {
+        if (!completer_.joinable()) return;
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            done = completer_done_;
+        }
+        if (!done) {
+            std::lock_guard<std::mutex> lock(sq_mutex_);
+            io_uring_sqe* sqe = next_sqe_locked();
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = URING_STOP_TAG;
+            flush_locked();
+        }
+        completer_.join();
+    }
+
+    // False if the write failed. Writing nothing counts as failing: a full
+    // or closed file would return 0 again for every retry.
+    bool complete(int index, size_t skip, int res) {
+        Buffer& buf = buffers_[index];
+        if (res <= 0) {
+            failed_.store(true);
+        } else if (skip + static_cast<size_t>(res) < buf.used) {
+            // Short write: queue the rest of the same buffer
+            std::lock_guard<std::mutex> lock(sq_mutex_);
+            queue_write_locked(index, skip + static_cast<size_t>(res), offsets_[index]);
+            flush_locked();
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            free_.push_back(index);
+            in_flight_--;
+        }
+        free_cv_.notify_all();
+        return res > 0;
+    }
+
+    void teardown() {
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+        if (sqes_ && sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_size_);
+        if (sq_ring_ && sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_size_);
+        for (auto& buf : buffers_) free(buf.data);
+        if (file_fd_ >= 0) ::close(file_fd_);
+    }
+
+    int ring_fd_ = -1, file_fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+    unsigned int *sq_tail_ = nullptr, *sq_array_ = nullptr, *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned int sq_mask_ = 0, cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    Buffer buffers_[URING_BUFFERS];
+    uint64_t offsets_[URING_BUFFERS] = {};
+    int current_ = -1;
+    uint64_t file_offset_ = 0;
+
+    std::mutex sq_mutex_;
+    unsigned int unsubmitted_ = 0;
+
+    std::mutex free_mutex_;
+    std::condition_variable free_cv_;
+    std::vector<int> free_;
+    int in_flight_ = 0;
+    bool completer_done_ = false;
+
+    std::atomic<bool> failed_{false};
+    std::thread completer_;
+};
+
+std::unique_ptr<TrajectorySink> open_uring_sink(const std::string& path) {
+    std::unique_ptr<UringSink> sink(new UringSink());
+    if (!sink->init(path)) return nullptr;
+    return sink;
+}
+
+#else
+
+std::unique_ptr<TrajectorySink> open_uring_sink(const std::string&) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,24 @@
+//
+// Linux io_uring output backend for the recorder and the checkpoint writer.
+//
+
+#ifndef URING_SINK_H
+#define URING_SINK_H
+
+#include <memory>
+#include <string>
+
+#include "trajectory.h"
+
+// Registered buffers and their size; writes are copied into them and each
+// full buffer becomes one fixed-buffer write at the next file offset
+#define URING_BUFFERS 16
+#define URING_BUFFER_BYTES (1 << 20)
+// Full buffers gathered before one io_uring_enter submits them together
+#define URING_SUBMIT_BATCH 4
+
+// Returns nullptr when io_uring is unavailable (old kernel, seccomp, not
+// Linux), so callers can fall back to open_file_sink()
+std::unique_ptr<TrajectorySink> open_uring_sink(const std::string& path);
+
+#endif //URING_SINK_H
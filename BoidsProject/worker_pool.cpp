@@ -0,0 +1,62 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+WorkerPool::WorkerPool(unsigned int num_threads, unsigned int spin_iters)
+    : num_threads_(num_threads ? num_threads : 1), barrier_(num_threads_, spin_iters),
+      arrival_(new PaddedTime[num_threads_]) {
+    for (unsigned int i = 1; i < num_threads_; i++) {
+        workers_.emplace_back(&WorkerPool::worker_loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    // job_ and stop_ are published to the workers by the barrier itself
+    stop_ = true;
+    barrier_.wait(0);
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(const std::function<void(unsigned int)>& job) {
+    job_ = &job;
+    barrier_.wait(0);
+    job(0);
+    timed_wait(0);
+    job_ = nullptr;
+}
+
+void WorkerPool::worker_loop(unsigned int thread_id) {
+    while (true) {
+        barrier_.wait(thread_id);
+        if (stop_) break;
+        (*job_)(thread_id);
+        timed_wait(thread_id);
+    }
+}
+
+void WorkerPool::timed_wait(unsigned int thread_id) {
+    // Stamped before arriving, so the barrier itself publishes it to the caller
+    arrival_[thread_id].seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    barrier_.wait(thread_id);
+}
+
+// A thread waits from its own arrival until the last thread arrives
+double WorkerPool::last_barrier_wait_total() const {
+    double last = 0.0, total = 0.0;
+    for (unsigned int i = 0; i < num_threads_; i++) last = std::max(last, arrival_[i].seconds);
+    for (unsigned int i = 0; i < num_threads_; i++) total += last - arrival_[i].seconds;
+    return total;
+}
+
+double WorkerPool::last_barrier_wait_max() const {
+    double first = arrival_[0].seconds, last = arrival_[0].seconds;
+    for (unsigned int i = 1; i < num_threads_; i++) {
+        first = std::min(first, arrival_[i].seconds);
+        last = std::max(last, arrival_[i].seconds);
+    }
+    return last - first;
+}
@@ -0,0 +1,52 @@
+//
+// Persistent pool of worker threads driven by a StepBarrier.
+//
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "step_barrier.h"
+
+// The calling thread acts as worker 0, so a pool of N threads spawns N - 1.
+// Workers stay alive between steps and park on the barrier while idle,
+// which replaces the create/join round trip of every update.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned int num_threads, unsigned int spin_iters = DEFAULT_SPIN_ITERS);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Runs job(thread_id) on every thread and returns once all of them finished
+    void run(const std::function<void(unsigned int)>& job);
+
+    unsigned int size() const { return num_threads_; }
+
+    // Seconds the threads spent waiting for stragglers in the closing barrier
+    // of the last run, summed over threads and for the earliest finisher
+    double last_barrier_wait_total() const;
+    double last_barrier_wait_max() const;
+
+private:
+    struct alignas(64) PaddedTime {
+        double seconds = 0.0;
+    };
+
+    void worker_loop(unsigned int thread_id);
+    void timed_wait(unsigned int thread_id);
+
+    unsigned int num_threads_;
+    StepBarrier barrier_;
+    std::vector<std::thread> workers_;
+    std::unique_ptr<PaddedTime[]> arrival_;
+    const std::function<void(unsigned int)>* job_ = nullptr;
+    bool stop_ = false;
+};
+
+#endif //WORKER_POOL_H